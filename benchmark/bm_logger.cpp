@@ -11,6 +11,7 @@
 #include <spdlog/spdlog.h>
 #include <lights/logger.h>
 #include <lights/sinks/file_sink.h>
+#include <lights/sinks/async_sink.h>
 
 
 #define LOGGER_FILENAME(device) device == 0 ? "/dev/null" : __func__
@@ -77,6 +78,50 @@ void BM_logger_more_lights_BinaryLogger(benchmark::State& state)
 	}
 }
 
+// --------------- General message with asynchronous sink ---------------
+
+void BM_logger_async_lights_TextLogger(benchmark::State& state)
+{
+	int device = state.range(0);
+	lights::sinks::SimpleFileSink file_sink(LOGGER_FILENAME(device));
+	lights::sinks::AsyncSink async_sink(file_sink);
+	lights::TextLogger logger("log", async_sink);
+
+	while (state.KeepRunning())
+	{
+		LIGHTS_INFO(logger, "");
+	}
+}
+
+
+void BM_logger_async_lights_BinaryLogger(benchmark::State& state)
+{
+	int device = state.range(0);
+	lights::sinks::SimpleFileSink file_sink(LOGGER_FILENAME(device));
+	lights::sinks::AsyncSink async_sink(file_sink);
+	lights::StringTable str_table("log_str_table");
+	lights::BinaryLogger logger("bin-log", async_sink, str_table);
+
+	while (state.KeepRunning())
+	{
+		LIGHTS_INFO(logger, "");
+	}
+}
+
+
+void BM_logger_async_lights_DeferredTextLogger(benchmark::State& state)
+{
+	int device = state.range(0);
+	lights::sinks::SimpleFileSink file_sink(LOGGER_FILENAME(device));
+	lights::sinks::AsyncSink async_sink(file_sink);
+	lights::DeferredTextLogger logger("log", async_sink);
+
+	while (state.KeepRunning())
+	{
+		LIGHTS_INFO(logger, "");
+	}
+}
+
 void BM_logger()
 {
 #define LOGGER_BENCHMARK(func) BENCHMARK(func)->Arg(0)->Arg(1)
@@ -84,4 +129,7 @@ void BM_logger()
 	LOGGER_BENCHMARK(BM_logger_lights_TextLogger);
 	LOGGER_BENCHMARK(BM_logger_more_lights_TextLogger);
 	LOGGER_BENCHMARK(BM_logger_more_lights_BinaryLogger);
+	LOGGER_BENCHMARK(BM_logger_async_lights_TextLogger);
+	LOGGER_BENCHMARK(BM_logger_async_lights_BinaryLogger);
+	LOGGER_BENCHMARK(BM_logger_async_lights_DeferredTextLogger);
 }
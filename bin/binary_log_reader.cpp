@@ -6,6 +6,17 @@
 
 #include <string>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <map>
+#include <memory>
+#include <vector>
+#include <ctime>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
 
 #include <lights/format.h>
 #include <lights/logger.h>
@@ -15,16 +26,398 @@ enum class ReadModeType
 {
 	JUMP_TO_LINE,
 	FOLLOW_FILE_GROWS,
+	TIME_RANGE,
+	PARALLEL,
+	MERGE,
 };
 
 
-void read_log(lights::StringView log_filename, lights::StringView str_table_filename, ReadModeType read_mode, std::streamoff line)
+/**
+ * Number of block that render by a thread at a time in parallel mode.
+ */
+constexpr std::size_t PARALLEL_CHUNK_BLOCKS = 4;
+
+/**
+ * Milliseconds to wait file modification in follow mode. Checks file periodically in case of
+ * event is not supported, such as file on network file system.
+ */
+constexpr int FOLLOW_WAIT_TIMEOUT = 1000;
+
+
+/**
+ * Options that parse from command line.
+ */
+struct ReadOption
+{
+	ReadModeType mode = ReadModeType::JUMP_TO_LINE;
+	std::streamoff line = 0;
+	lights::PreciseTime begin_time = lights::PreciseTime(std::numeric_limits<std::int64_t>::min());
+	lights::PreciseTime end_time = lights::PreciseTime(std::numeric_limits<std::int64_t>::max());
+	std::size_t thread_count = std::thread::hardware_concurrency();
+	lights::LogLevel level = lights::LogLevel::DEBUG;
+	std::string logger;
+	std::string file;
+	std::string function;
+	std::string description;
+	std::vector<std::pair<const char*, const char*>> merge_inputs; // Pair of log file and string table file.
+};
+
+
+/**
+ * Opens string table file with read only, so reading never changes string table file that
+ * is using by writer. Uses an empty string table when file is not exist. Log file that has
+ * inline string table is read with its own strings instead of it.
+ */
+std::unique_ptr<lights::StringTable> open_str_table(lights::StringView filename)
+{
+	if (!lights::env::file_exists(filename.data()))
+	{
+		return std::unique_ptr<lights::StringTable>(new lights::StringTable());
+	}
+	return std::unique_ptr<lights::StringTable>(
+		new lights::StringTable(filename, lights::StringTableOpenMode::READ_ONLY));
+}
+
+
+void setup_filter(lights::BinaryLogFilter& filter, const ReadOption& option)
+{
+	filter.set_level(option.level);
+	filter.set_logger(option.logger);
+	filter.set_file(option.file);
+	filter.set_function(option.function);
+	filter.set_description(option.description);
+	filter.set_time_range(option.begin_time, option.end_time);
+}
+
+
+/**
+ * Merges log messages of the first file and files of merge inputs by time.
+ */
+void merge_log(lights::BinaryLogReader& first_reader, const ReadOption& option)
+{
+	std::vector<std::unique_ptr<lights::StringTable>> str_tables;
+	std::vector<std::unique_ptr<lights::BinaryLogFilter>> filters;
+	std::vector<std::unique_ptr<lights::BinaryLogReader>> readers;
+	lights::BinaryLogMerger merger;
+	merger.add_reader(first_reader);
+	for (auto& input : option.merge_inputs)
+	{
+		str_tables.push_back(open_str_table(input.second));
+		filters.emplace_back(new lights::BinaryLogFilter(*str_tables.back()));
+		setup_filter(*filters.back(), option);
+		readers.emplace_back(new lights::BinaryLogReader(input.first, *str_tables.back()));
+		readers.back()->set_filter(filters.back().get());
+		merger.add_reader(*readers.back());
+	}
+
+	while (true)
+	{
+		lights::StringView log = merger.read();
+		if (!lights::is_valid(log))
+		{
+			break;
+		}
+		lights::stdout_stream().write_line(log);
+	}
+}
+
+
+/**
+ * Parses local time that format is "YYYY-mm-dd HH:MM:SS.nnnnnnnnn" or seconds since epoch.
+ * Fraction of second is optional.
+ * @return Returns false when string is invalid.
+ */
+bool parse_time(const char* str, lights::PreciseTime& time)
+{
+	std::tm tm = {};
+	int fraction_begin = 0;
+	if (std::sscanf(str, "%d-%d-%d %d:%d:%d%n",
+					&tm.tm_year, &tm.tm_mon, &tm.tm_mday, &tm.tm_hour, &tm.tm_min, &tm.tm_sec, &fraction_begin) == 6)
+	{
+		tm.tm_year -= 1900;
+		tm.tm_mon -= 1;
+		tm.tm_isdst = -1;
+		time.seconds = std::mktime(&tm);
+	}
+	else
+	{
+		char* end = nullptr;
+		time.seconds = std::strtoll(str, &end, 10);
+		if (end == str)
+		{
+			return false;
+		}
+		fraction_begin = static_cast<int>(end - str);
+	}
+
+	// Pads fraction of second to nanoseconds.
+	time.nanoseconds = 0;
+	const char* fraction = str + fraction_begin;
+	if (*fraction == '.')
+	{
+		std::int64_t scale = lights::PreciseTime::NANOSECONDS_OF_SECOND;
+		for (++fraction; *fraction >= '0' && *fraction <= '9' && scale > 1; ++fraction)
+		{
+			scale /= 10;
+			time.nanoseconds += (*fraction - '0') * scale;
+		}
+	}
+	return true;
+}
+
+
+/**
+ * Renders chunks of block with multiple threads and writes log message in order of file.
+ * Each thread has its own reader, and rendered chunk is put into reorder buffer until all
+ * chunks in front of it are written. Strings of inline string table are read once and shared
+ * by all readers, so reader never scans file in front of its chunk for them.
+ */
+class ParallelRenderer
 {
-	lights::StringTable str_table(str_table_filename);
+public:
+	ParallelRenderer(lights::StringView log_filename,
+					 lights::StringTable& str_table,
+					 const lights::BinaryLogFilter& filter,
+					 std::size_t block_count) :
+		m_log_filename(log_filename),
+		m_str_table(str_table),
+		m_filter(filter),
+		m_block_count(block_count),
+		m_chunk_count((block_count + PARALLEL_CHUNK_BLOCKS - 1) / PARALLEL_CHUNK_BLOCKS),
+		m_max_pending_chunk(0),
+		m_next_render_chunk(0),
+		m_next_write_chunk(0),
+		m_rendered_chunks(),
+		m_error(),
+		m_str_reader(nullptr)
+	{}
+
+	void run(std::size_t thread_count)
+	{
+		lights::BinaryLogReader str_reader(m_log_filename, m_str_table);
+		m_str_reader = str_reader.load_inline_str_table() ? &str_reader : nullptr;
+
+		m_max_pending_chunk = thread_count * 2;
+		std::vector<std::thread> threads;
+		for (std::size_t i = 0; i < thread_count; ++i)
+		{
+			threads.emplace_back(&ParallelRenderer::render, this);
+		}
+
+		while (m_next_write_chunk < m_chunk_count)
+		{
+			std::string text;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_condition.wait(lock, [this]() {
+					return m_error || m_rendered_chunks.count(m_next_write_chunk) != 0;
+				});
+				if (m_error)
+				{
+					break;
+				}
+				auto itr = m_rendered_chunks.find(m_next_write_chunk);
+				text.swap(itr->second);
+				m_rendered_chunks.erase(itr);
+				++m_next_write_chunk;
+			}
+			m_condition.notify_all();
+			lights::stdout_stream().write(lights::SequenceView(text.data(), text.length()));
+		}
+
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+		if (m_error)
+		{
+			std::rethrow_exception(m_error);
+		}
+	}
+
+private:
+	void render()
+	{
+		try
+		{
+			lights::BinaryLogReader reader(m_log_filename, m_str_table);
+			if (m_str_reader != nullptr)
+			{
+				reader.share_inline_str_table(*m_str_reader);
+			}
+			lights::BinaryLogFilter filter(m_filter);
+			reader.set_filter(&filter);
+			while (true)
+			{
+				std::size_t chunk;
+				{
+					std::unique_lock<std::mutex> lock(m_mutex);
+					m_condition.wait(lock, [this]() {
+						return m_error || m_next_render_chunk >= m_chunk_count ||
+							m_next_render_chunk < m_next_write_chunk + m_max_pending_chunk;
+					});
+					if (m_error || m_next_render_chunk >= m_chunk_count)
+					{
+						return;
+					}
+					chunk = m_next_render_chunk++;
+				}
+
+				std::string text;
+				render_chunk(reader, chunk, text);
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_rendered_chunks[chunk].swap(text);
+				}
+				m_condition.notify_all();
+			}
+		}
+		catch (...)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_error = std::current_exception();
+			}
+			m_condition.notify_all();
+		}
+	}
+
+	/**
+	 * Renders log message that begin in blocks of chunk.
+	 * @note Reader may jump to the front of chunk, because the first block may have no header
+	 *       when it's cover by a large log message. That log message belong to the previous chunk.
+	 */
+	void render_chunk(lights::BinaryLogReader& reader, std::size_t chunk, std::string& text)
+	{
+		std::size_t begin_block = chunk * PARALLEL_CHUNK_BLOCKS;
+		std::size_t end_block = begin_block + PARALLEL_CHUNK_BLOCKS;
+		std::streamoff begin = reader.block_offset(begin_block);
+		std::streamoff end = (end_block < m_block_count) ?
+							 reader.block_offset(end_block) : std::numeric_limits<std::streamoff>::max();
+
+		reader.jump_to_block(begin_block);
+		while (true)
+		{
+			lights::StringView log = reader.read();
+			if (!lights::is_valid(log) || reader.message_offset() >= end)
+			{
+				break;
+			}
+			if (reader.message_offset() >= begin)
+			{
+				text.append(log.data(), log.length());
+				text.append(lights::env::end_line());
+			}
+		}
+	}
+
+	lights::StringView m_log_filename;
+	lights::StringTable& m_str_table;
+	const lights::BinaryLogFilter& m_filter;
+	std::size_t m_block_count;
+	std::size_t m_chunk_count;
+	std::size_t m_max_pending_chunk;
+	std::size_t m_next_render_chunk;
+	std::size_t m_next_write_chunk;
+	std::map<std::size_t, std::string> m_rendered_chunks; // Reorder buffer.
+	std::exception_ptr m_error;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	lights::BinaryLogReader* m_str_reader; // Reader that loads inline string table for all threads.
+};
+
+
+/**
+ * Reads files of rotating file sink as one logical stream.
+ */
+void read_rotating_log(lights::StringView name_format, lights::StringView str_table_filename, const ReadOption& option)
+{
+	std::unique_ptr<lights::StringTable> str_table_ptr = open_str_table(str_table_filename);
+	lights::StringTable& str_table = *str_table_ptr;
+	lights::BinaryLogFilter filter(str_table);
+	setup_filter(filter, option);
+	lights::RotatingBinaryLogReader reader(name_format, str_table);
+	reader.set_filter(&filter);
+
+	auto read_all = [&reader]() {
+		while (true)
+		{
+			lights::StringView log = reader.read();
+			if (!lights::is_valid(log))
+			{
+				break;
+			}
+			lights::stdout_stream().write_line(log);
+		}
+	};
+
+	if (option.mode != ReadModeType::FOLLOW_FILE_GROWS)
+	{
+		read_all();
+		return;
+	}
+
+	// Watches directory to know new file is created by rotating.
+	std::string format = name_format.to_std_string();
+	std::size_t slash_pos = format.rfind('/', format.find("{}"));
+	std::string directory = (slash_pos == std::string::npos) ? "." : format.substr(0, slash_pos + 1);
+	lights::FileWatcher watcher;
+	watcher.watch_directory(directory);
+	reader.jump_to_end();
+	std::string watching_filename;
+	while (true)
+	{
+		read_all();
+		lights::stdout_stream().flush();
+
+		// Log message may be write into new file before it's watched, so reads again after watching.
+		if (reader.filename() != watching_filename && !reader.filename().empty())
+		{
+			watching_filename = reader.filename();
+			watcher.watch(watching_filename);
+			continue;
+		}
+		watcher.wait(FOLLOW_WAIT_TIMEOUT);
+	}
+}
+
+
+void read_log(lights::StringView log_filename, lights::StringView str_table_filename, const ReadOption& option)
+{
+	std::unique_ptr<lights::StringTable> str_table_ptr = open_str_table(str_table_filename);
+	lights::StringTable& str_table = *str_table_ptr;
+	lights::BinaryLogFilter filter(str_table);
+	setup_filter(filter, option);
+
 	lights::BinaryLogReader reader(log_filename, str_table);
-	if (read_mode == ReadModeType::JUMP_TO_LINE)
+	reader.set_filter(&filter);
+	std::size_t block_count = reader.block_count();
+	if (option.mode == ReadModeType::PARALLEL && option.thread_count > 1 && block_count > PARALLEL_CHUNK_BLOCKS)
 	{
-		reader.jump(line);
+		ParallelRenderer renderer(log_filename, str_table, filter, block_count);
+		renderer.run(option.thread_count);
+	}
+	else if (option.mode == ReadModeType::MERGE)
+	{
+		merge_log(reader, option);
+	}
+	else if (option.mode == ReadModeType::TIME_RANGE)
+	{
+		reader.seek_time(option.begin_time);
+
+		while (!reader.eof())
+		{
+			lights::StringView log = reader.read();
+			if (!lights::is_valid(log) || reader.message_time() > option.end_time)
+			{
+				break;
+			}
+			lights::stdout_stream().write_line(log);
+		}
+	}
+	else if (option.mode == ReadModeType::JUMP_TO_LINE || option.mode == ReadModeType::PARALLEL)
+	{
+		reader.jump(option.line);
 
 		while (!reader.eof())
 		{
@@ -38,11 +431,15 @@ void read_log(lights::StringView log_filename, lights::StringView str_table_file
 	}
 	else
 	{
+		// Creates watcher before jumping to end, so modification after that will not be missed.
+		lights::FileWatcher watcher(log_filename);
 		reader.jump_to_end();
 		while (true)
 		{
 			if (reader.have_new_message())
 			{
+				// Reads all complete log messages. Incomplete log message at the tail is read again
+				// after next modification.
 				reader.clear_eof();
 				while (!reader.eof())
 				{
@@ -53,37 +450,187 @@ void read_log(lights::StringView log_filename, lights::StringView str_table_file
 					}
 					lights::stdout_stream().write_line(log);
 				}
+				lights::stdout_stream().flush();
 			}
-			std::this_thread::sleep_for(std::chrono::microseconds(100));
+			watcher.wait(FOLLOW_WAIT_TIMEOUT);
 		}
 	}
 }
 
 
+/**
+ * Parses option that format is "--name=value".
+ * @return Returns false when option is invalid.
+ */
+bool parse_named_option(lights::StringView arg, ReadOption& option)
+{
+	std::string str = arg.to_std_string();
+	std::size_t equal_pos = str.find('=');
+	if (equal_pos == std::string::npos)
+	{
+		return false;
+	}
+
+	std::string name = str.substr(2, equal_pos - 2);
+	std::string value = str.substr(equal_pos + 1);
+	if (name == "level")
+	{
+		for (auto level : {lights::LogLevel::DEBUG, lights::LogLevel::INFO, lights::LogLevel::WARN, lights::LogLevel::ERROR})
+		{
+			if (lights::to_string(level).to_std_string() == value)
+			{
+				option.level = level;
+				return true;
+			}
+		}
+		return false;
+	}
+	else if (name == "logger")
+	{
+		option.logger = value;
+	}
+	else if (name == "file")
+	{
+		option.file = value;
+	}
+	else if (name == "function")
+	{
+		option.function = value;
+	}
+	else if (name == "description")
+	{
+		option.description = value;
+	}
+	else if (name == "begin")
+	{
+		return parse_time(value.c_str(), option.begin_time);
+	}
+	else if (name == "end")
+	{
+		return parse_time(value.c_str(), option.end_time);
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+
 int main(int argc, const char* argv[])
 {
-	if (argc < 2)
+	ReadOption option;
+	std::vector<const char*> args; // Positional arguments.
+	for (int i = 0; i < argc; ++i)
+	{
+		if (i != 0 && std::strncmp(argv[i], "--", 2) == 0)
+		{
+			if (!parse_named_option(argv[i], option))
+			{
+				lights::stdout_stream() << "Invalid option " << argv[i] << ".\n";
+				return EXIT_FAILURE;
+			}
+		}
+		else
+		{
+			args.push_back(argv[i]);
+		}
+	}
+
+	if (args.size() < 2)
 	{
 		lights::stdout_stream() << "Pass a binary log file and read it.\n";
-		lights::stdout_stream() << "    %1: Binary log filename.\n";
+		lights::stdout_stream() << "    %1: Binary log filename. Name format of rotating file sink that has placeholder '{}'\n";
+		lights::stdout_stream() << "        is use to read all rotating files as one, and only read all or follow file grows is support.\n";
 		lights::stdout_stream() << "    %2: Log string table filename or default is 'log_str_table'.\n";
-		lights::stdout_stream() << "    %3: Mode: jump to line('j') or follow file grows('f').\n";
+		lights::stdout_stream() << "        Not use when log file has inline string table, strings of log file are used.\n";
+		lights::stdout_stream() << "    %3: Mode: jump to line('j'), follow file grows('f'), time range('t'), parallel('p') or merge('m').\n";
 		lights::stdout_stream() << "    %4: Read at line when mode is jump to line('j').\n";
+		lights::stdout_stream() << "        Begin time when mode is time range('t').\n";
+		lights::stdout_stream() << "        Number of thread when mode is parallel('p'), default is number of cpu.\n";
+		lights::stdout_stream() << "    %5: End time when mode is time range('t'), default is no end.\n";
+		lights::stdout_stream() << "        Time format is 'YYYY-mm-dd HH:MM:SS.nnnnnnnnn' or seconds since epoch.\n";
+		lights::stdout_stream() << "    %4 %5 ...: Pairs of binary log filename and string table filename when mode is merge('m').\n";
+		lights::stdout_stream() << "        Log messages of all files are merged by time.\n";
+		lights::stdout_stream() << "Options to filter log message that can be place at any position.\n";
+		lights::stdout_stream() << "    --level=<level>: Level is not lower than debug, info, warning or error.\n";
+		lights::stdout_stream() << "    --logger=<text>: Logger name contains text.\n";
+		lights::stdout_stream() << "    --file=<text>: Source file contains text.\n";
+		lights::stdout_stream() << "    --function=<text>: Function contains text.\n";
+		lights::stdout_stream() << "    --description=<text>: Description (format string) contains text.\n";
+		lights::stdout_stream() << "    --begin=<time>: Time is not early than begin time.\n";
+		lights::stdout_stream() << "    --end=<time>: Time is not later than end time.\n";
 		return EXIT_FAILURE;
 	}
 
-	const char* log_filename = argv[1];
-	const char* str_table_filename = (argc > 2) ? argv[2] : "log_str_table";
-	ReadModeType read_mode = ReadModeType::JUMP_TO_LINE;
-	if (argc > 3 && *argv[3] == 'f')
+	const char* log_filename = args[1];
+	const char* str_table_filename = (args.size() > 2) ? args[2] : "log_str_table";
+	if (args.size() > 3 && *args[3] == 'f')
+	{
+		option.mode = ReadModeType::FOLLOW_FILE_GROWS;
+	}
+	else if (args.size() > 3 && *args[3] == 't')
 	{
-		read_mode = ReadModeType::FOLLOW_FILE_GROWS;
+		option.mode = ReadModeType::TIME_RANGE;
+	}
+	else if (args.size() > 3 && *args[3] == 'p')
+	{
+		option.mode = ReadModeType::PARALLEL;
+	}
+	else if (args.size() > 3 && *args[3] == 'm')
+	{
+		option.mode = ReadModeType::MERGE;
+	}
+
+	if (option.mode == ReadModeType::TIME_RANGE)
+	{
+		if (args.size() < 5 ||
+			!parse_time(args[4], option.begin_time) ||
+			(args.size() > 5 && !parse_time(args[5], option.end_time)))
+		{
+			lights::stdout_stream() << "Invalid time.\n";
+			return EXIT_FAILURE;
+		}
+	}
+	else if (option.mode == ReadModeType::JUMP_TO_LINE && args.size() > 4)
+	{
+		option.line = std::stoll(args[4]);
+	}
+	else if (option.mode == ReadModeType::PARALLEL && args.size() > 4)
+	{
+		option.thread_count = std::stoul(args[4]);
+	}
+	else if (option.mode == ReadModeType::MERGE)
+	{
+		if (args.size() % 2 != 0)
+		{
+			lights::stdout_stream() << "Missing string table filename of " << args.back() << ".\n";
+			return EXIT_FAILURE;
+		}
+		for (std::size_t i = 4; i < args.size(); i += 2)
+		{
+			option.merge_inputs.emplace_back(args[i], args[i + 1]);
+		}
+	}
+
+	bool is_rotating = lights::StringView(log_filename).to_std_string().find("{}") != std::string::npos;
+	if (is_rotating && !(option.mode == ReadModeType::FOLLOW_FILE_GROWS ||
+						 (option.mode == ReadModeType::JUMP_TO_LINE && option.line == 0)))
+	{
+		lights::stdout_stream() << "Only support to read all or follow file grows with rotating files.\n";
+		return EXIT_FAILURE;
 	}
-	const std::streamoff line = (argc > 4) ? std::stoll(argv[4]) : 0;
 
 	try
 	{
-		read_log(log_filename, str_table_filename, read_mode, line);
+		if (is_rotating)
+		{
+			read_rotating_log(log_filename, str_table_filename, option);
+		}
+		else
+		{
+			read_log(log_filename, str_table_filename, option);
+		}
 	}
 	catch (lights::Exception& ex)
 	{
@@ -11,6 +11,7 @@
 #include <lights/logger.h>
 #include <lights/sinks/file_sink.h>
 #include <lights/sinks/stdout_sink.h>
+#include <lights/sinks/async_sink.h>
 
 
 namespace lights {
@@ -88,10 +89,65 @@ void example_BinaryLogger()
 }
 
 
+void example_BinaryLogFileFormat()
+{
+	lights::StringView log_filename = "compact_log.log";
+	lights::StringTable str_table("log_str_table");
+	// Information of call site is put into string table, log message only records call site id.
+	lights::BinaryLogFileFormat file_format(str_table);
+	lights::sinks::SimpleFileSink file_sink(log_filename, &file_format);
+	lights::BinaryLogger logger("compact_log", file_sink, str_table);
+	// Small integer use less space with varint.
+	logger.set_integer_encoding(lights::BinaryIntegerEncoding::VARINT);
+
+	LIGHTS_INFO(logger, "Current timestamp is {}", lights::current_timestamp());
+
+	// Reader can detect the format of file.
+	lights::BinaryLogReader reader(log_filename, str_table);
+	while (!reader.eof())
+	{
+		auto log = reader.read();
+		if (!is_valid(log))
+		{
+			break;
+		}
+		lights::stdout_stream().write_line(log);
+	}
+}
+
+
+void example_AsyncSink()
+{
+	lights::sinks::SimpleFileSink file_sink("async_logger.log");
+	// Backend thread write log message into file sink, so the caller thread will not wait for io.
+	lights::sinks::AsyncSink async_sink(file_sink);
+	lights::TextLogger logger("async_logger", async_sink);
+
+	LIGHTS_INFO(logger, "Current timestamp is {}", lights::current_timestamp());
+
+	// Wait for all log message are write to file.
+	async_sink.flush();
+}
+
+
+void example_DeferredTextLogger()
+{
+	lights::sinks::SimpleFileSink file_sink("deferred_logger.log");
+	lights::sinks::AsyncSink async_sink(file_sink);
+	// Only store arguments in this thread, and format text in backend thread of async sink.
+	lights::DeferredTextLogger logger("deferred_logger", async_sink);
+
+	LIGHTS_INFO(logger, "Current timestamp is {}", lights::current_timestamp());
+}
+
+
 void example_log()
 {
 	example_TextLogger();
 	example_BinaryLogger();
+	example_BinaryLogFileFormat();
+	example_AsyncSink();
+	example_DeferredTextLogger();
 }
 
 } // namespace example
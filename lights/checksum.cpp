@@ -0,0 +1,135 @@
+/**
+ * checksum.cpp
+ * @author wherewindblow
+ * @date   Oct 16, 2026
+ */
+
+#include "checksum.h"
+
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#	define LIGHTS_CRC32C_SSE42
+#	include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+#	define LIGHTS_CRC32C_ARM
+#	include <arm_acle.h>
+#endif
+
+
+namespace lights {
+
+namespace details {
+
+/**
+ * Reversed polynomial of CRC32C.
+ */
+constexpr std::uint32_t CRC32C_POLYNOMIAL = 0x82F63B78;
+
+struct Crc32cTable
+{
+	Crc32cTable()
+	{
+		for (std::uint32_t i = 0; i < 256; ++i)
+		{
+			std::uint32_t crc = i;
+			for (int bit = 0; bit < 8; ++bit)
+			{
+				crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLYNOMIAL : crc >> 1;
+			}
+			value[i] = crc;
+		}
+	}
+
+	std::uint32_t value[256];
+};
+
+
+std::uint32_t crc32c_software(const std::uint8_t* data, std::size_t length, std::uint32_t crc)
+{
+	static const Crc32cTable table;
+	for (std::size_t i = 0; i < length; ++i)
+	{
+		crc = table.value[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return crc;
+}
+
+
+#if defined(LIGHTS_CRC32C_SSE42)
+
+__attribute__((target("sse4.2")))
+std::uint32_t crc32c_hardware(const std::uint8_t* data, std::size_t length, std::uint32_t crc)
+{
+#if defined(__x86_64__)
+	std::uint64_t crc64 = crc;
+	for (; length >= sizeof(std::uint64_t); length -= sizeof(std::uint64_t), data += sizeof(std::uint64_t))
+	{
+		std::uint64_t word;
+		std::memcpy(&word, data, sizeof(word));
+		crc64 = _mm_crc32_u64(crc64, word);
+	}
+	crc = static_cast<std::uint32_t>(crc64);
+#endif
+	for (; length >= sizeof(std::uint32_t); length -= sizeof(std::uint32_t), data += sizeof(std::uint32_t))
+	{
+		std::uint32_t word;
+		std::memcpy(&word, data, sizeof(word));
+		crc = _mm_crc32_u32(crc, word);
+	}
+	for (; length > 0; --length, ++data)
+	{
+		crc = _mm_crc32_u8(crc, *data);
+	}
+	return crc;
+}
+
+
+bool have_crc32c_instruction()
+{
+	static const bool have = __builtin_cpu_supports("sse4.2");
+	return have;
+}
+
+#elif defined(LIGHTS_CRC32C_ARM)
+
+std::uint32_t crc32c_hardware(const std::uint8_t* data, std::size_t length, std::uint32_t crc)
+{
+	for (; length >= sizeof(std::uint64_t); length -= sizeof(std::uint64_t), data += sizeof(std::uint64_t))
+	{
+		std::uint64_t word;
+		std::memcpy(&word, data, sizeof(word));
+		crc = __crc32cd(crc, word);
+	}
+	for (; length > 0; --length, ++data)
+	{
+		crc = __crc32cb(crc, *data);
+	}
+	return crc;
+}
+
+
+inline bool have_crc32c_instruction()
+{
+	return true;
+}
+
+#endif
+
+} // namespace details
+
+
+std::uint32_t crc32c(SequenceView data, std::uint32_t crc)
+{
+	auto bytes = static_cast<const std::uint8_t*>(data.data());
+	crc = ~crc;
+#if defined(LIGHTS_CRC32C_SSE42) || defined(LIGHTS_CRC32C_ARM)
+	if (details::have_crc32c_instruction())
+	{
+		return ~details::crc32c_hardware(bytes, data.length(), crc);
+	}
+#endif
+	return ~details::crc32c_software(bytes, data.length(), crc);
+}
+
+} // namespace lights
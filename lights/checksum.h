@@ -0,0 +1,23 @@
+/**
+ * checksum.h
+ * @author wherewindblow
+ * @date   Oct 16, 2026
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include "sequence.h"
+
+
+namespace lights {
+
+/**
+ * Computes CRC32C (Castagnoli) of @c data.
+ * @param crc  Result of the previous data, use to compute checksum of separate data as a whole.
+ * @note Uses crc32 instruction when CPU supports, otherwise uses lookup table.
+ */
+std::uint32_t crc32c(SequenceView data, std::uint32_t crc = 0);
+
+} // namespace lights
@@ -0,0 +1,188 @@
+/**
+ * file.cpp
+ * @author wherewindblow
+ * @date   Oct 16, 2026
+ */
+
+#include "file.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+namespace lights {
+
+namespace details {
+
+int to_madvise_advice(MappedFileAdvice advice)
+{
+	switch (advice)
+	{
+		case MappedFileAdvice::SEQUENTIAL:
+			return MADV_SEQUENTIAL;
+		case MappedFileAdvice::RANDOM:
+			return MADV_RANDOM;
+		default:
+			return MADV_NORMAL;
+	}
+}
+
+} // namespace details
+
+
+MappedFileStream::MappedFileStream(StringView filename) :
+	m_filename(filename.to_std_string()),
+	m_fd(::open(m_filename.c_str(), O_RDONLY)),
+	m_data(nullptr),
+	m_mapped_size(0),
+	m_pos(0),
+	m_eof(false),
+	m_advice(MappedFileAdvice::NORMAL)
+{
+	if (m_fd == -1)
+	{
+		LIGHTS_THROW(OpenFileError, filename);
+	}
+
+	try
+	{
+		remap();
+	}
+	catch (...)
+	{
+		::close(m_fd);
+		throw;
+	}
+}
+
+
+MappedFileStream::~MappedFileStream()
+{
+	if (m_data != nullptr)
+	{
+		::munmap(const_cast<std::uint8_t*>(m_data), m_mapped_size);
+	}
+	::close(m_fd);
+}
+
+
+void MappedFileStream::advise(MappedFileAdvice advice)
+{
+	m_advice = advice;
+	if (m_data != nullptr)
+	{
+		::madvise(const_cast<std::uint8_t*>(m_data), m_mapped_size, details::to_madvise_advice(advice));
+	}
+}
+
+
+bool MappedFileStream::remap()
+{
+	struct stat file_stat;
+	if (::fstat(m_fd, &file_stat) == -1)
+	{
+		LIGHTS_THROW(OpenFileError, m_filename);
+	}
+
+	std::size_t file_size = static_cast<std::size_t>(file_stat.st_size);
+	if (file_size <= m_mapped_size)
+	{
+		return false;
+	}
+
+	void* data = ::mmap(nullptr, file_size, PROT_READ, MAP_SHARED, m_fd, 0);
+	if (data == MAP_FAILED)
+	{
+		LIGHTS_THROW(OpenFileError, m_filename);
+	}
+
+	if (m_data != nullptr)
+	{
+		::munmap(const_cast<std::uint8_t*>(m_data), m_mapped_size);
+	}
+	m_data = static_cast<const std::uint8_t*>(data);
+	m_mapped_size = file_size;
+	if (m_advice != MappedFileAdvice::NORMAL)
+	{
+		::madvise(data, m_mapped_size, details::to_madvise_advice(m_advice));
+	}
+	return true;
+}
+
+
+
+FileWatcher::FileWatcher() :
+	m_fd(::inotify_init1(IN_NONBLOCK | IN_CLOEXEC)),
+	m_file_wd(-1)
+{
+	if (m_fd == -1)
+	{
+		LIGHTS_THROW(OpenFileError, "inotify");
+	}
+}
+
+
+FileWatcher::FileWatcher(StringView filename) :
+	FileWatcher()
+{
+	watch(filename);
+}
+
+
+FileWatcher::~FileWatcher()
+{
+	::close(m_fd);
+}
+
+
+void FileWatcher::watch(StringView filename)
+{
+	std::string name = filename.to_std_string();
+	int wd = ::inotify_add_watch(m_fd, name.c_str(), IN_MODIFY);
+	if (wd == -1)
+	{
+		LIGHTS_THROW(OpenFileError, filename);
+	}
+
+	// Same file gets the same watch descriptor.
+	if (m_file_wd != -1 && m_file_wd != wd)
+	{
+		::inotify_rm_watch(m_fd, m_file_wd);
+	}
+	m_file_wd = wd;
+}
+
+
+void FileWatcher::watch_directory(StringView dirname)
+{
+	std::string name = dirname.to_std_string();
+	if (::inotify_add_watch(m_fd, name.c_str(), IN_CREATE | IN_MOVED_TO) == -1)
+	{
+		LIGHTS_THROW(OpenFileError, dirname);
+	}
+}
+
+
+bool FileWatcher::wait(int timeout)
+{
+	pollfd poll_fd;
+	poll_fd.fd = m_fd;
+	poll_fd.events = POLLIN;
+	poll_fd.revents = 0;
+	if (::poll(&poll_fd, 1, timeout) <= 0)
+	{
+		return false;
+	}
+
+	// Events of a batch of write are merged, so reads all events at once.
+	char events[4096] __attribute__((aligned(__alignof__(inotify_event))));
+	while (::read(m_fd, events, sizeof(events)) > 0)
+	{
+	}
+	return true;
+}
+
+} // namespace lights
\ No newline at end of file
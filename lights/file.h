@@ -7,6 +7,9 @@
 #pragma once
 
 #include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
 
 #include "config.h"
 #include "env.h"
@@ -291,6 +294,162 @@ inline FileStream& stderr_stream()
 	return stream;
 }
 
+/**
+ * Access pattern advice of mapped file.
+ */
+enum class MappedFileAdvice
+{
+	NORMAL,
+	SEQUENTIAL,
+	RANDOM,
+};
+
+
+/**
+ * MappedFileStream provide read operation with a memory mapped file. The interface of read is
+ * same as FileStream, and can get content of file without copy by @c view.
+ * @note Mapping is extended automatically when reads to the end of mapping and file has grown.
+ *       File must not be truncated while it's mapping.
+ */
+class MappedFileStream : public NonCopyable
+{
+public:
+	/**
+	 * Opens a file with @c filename and maps it with read only.
+	 * @throw Thrown OpenFileError when have error.
+	 */
+	explicit MappedFileStream(StringView filename);
+
+	/**
+	 * Unmaps and closes the file.
+	 */
+	~MappedFileStream();
+
+	/**
+	 * Reads file content into @c sequence.
+	 * @return Number of read successfully.
+	 */
+	std::size_t read(Sequence sequence);
+
+	/**
+	 * Returns content of file that start at @c offset without copy.
+	 * @return Returns invalid sequence view when file have not enough content.
+	 * @note Returned content is only valid until the mapping is extended, that is reading,
+	 *       seeking to end or getting size again.
+	 */
+	SequenceView view(std::streamoff offset, std::size_t length);
+
+	/**
+	 * Reads a character.
+	 */
+	int get_char();
+
+	/**
+	 * Reads the next character without extracting it.
+	 */
+	int peek();
+
+	/**
+	 * Checks is end of file.
+	 */
+	bool eof() const;
+
+	/**
+	 * Clears error state.
+	 */
+	void clear_error();
+
+	/**
+	 * Returns the current file position indicator.
+	 */
+	std::streamoff tell() const;
+
+	/**
+	 * Moves the file position indicator to a specific location in a file.
+	 */
+	void seek(std::streamoff off, FileSeekWhence whence);
+
+	/**
+	 * Returns the size of a file.
+	 */
+	std::size_t size();
+
+	/**
+	 * Advises kernel how the mapping will be access. It's keep after mapping is extended.
+	 */
+	void advise(MappedFileAdvice advice);
+
+private:
+	/**
+	 * Extends mapping to cover current file content.
+	 * @return Returns false when file have not grown.
+	 */
+	bool remap();
+
+	/**
+	 * Ensures mapping can cover to @c end.
+	 */
+	bool ensure_mapped(std::streamoff end);
+
+	std::string m_filename;
+	int m_fd;
+	const std::uint8_t* m_data;
+	std::size_t m_mapped_size;
+	std::streamoff m_pos;
+	bool m_eof;
+	MappedFileAdvice m_advice;
+};
+
+
+/**
+ * FileWatcher waits for a file to be modified by inotify, so it's not need to poll the file.
+ * @details Event that occur after watcher is created and before wait is not lost.
+ */
+class FileWatcher : public NonCopyable
+{
+public:
+	/**
+	 * Creates watcher that watches nothing.
+	 * @throw Thrown OpenFileError when have error.
+	 */
+	FileWatcher();
+
+	/**
+	 * Watches the file with @c filename.
+	 * @throw Thrown OpenFileError when have error.
+	 */
+	explicit FileWatcher(StringView filename);
+
+	/**
+	 * Stops watching.
+	 */
+	~FileWatcher();
+
+	/**
+	 * Watches the file with @c filename instead of the previous one.
+	 * @throw Thrown OpenFileError when have error.
+	 */
+	void watch(StringView filename);
+
+	/**
+	 * Watches file that is created or moved into directory with @c dirname too.
+	 * @throw Thrown OpenFileError when have error.
+	 */
+	void watch_directory(StringView dirname);
+
+	/**
+	 * Waits until file is modified or timeout. All pending events are consumed.
+	 * @param timeout  Milliseconds of timeout, and negative value means waits forever.
+	 * @return Returns false when timeout.
+	 */
+	bool wait(int timeout);
+
+private:
+	int m_fd;
+	int m_file_wd;
+};
+
+
 /**
  * Sink adapter of file stream.
  */
@@ -331,4 +490,94 @@ inline FileStream& operator<< (FileStream& out, StringView str)
 	return out;
 }
 
+// ========================= Implement. =========================
+
+inline std::size_t MappedFileStream::read(Sequence sequence)
+{
+	std::size_t length = sequence.length();
+	if (!ensure_mapped(m_pos + static_cast<std::streamoff>(length)))
+	{
+		length = (m_pos < static_cast<std::streamoff>(m_mapped_size)) ? m_mapped_size - m_pos : 0;
+		m_eof = true;
+	}
+	if (length != 0)
+	{
+		std::memcpy(sequence.data(), m_data + m_pos, length);
+	}
+	m_pos += length;
+	return length;
+}
+
+inline SequenceView MappedFileStream::view(std::streamoff offset, std::size_t length)
+{
+	if (offset < 0 || !ensure_mapped(offset + static_cast<std::streamoff>(length)))
+	{
+		return invalid_sequence_view();
+	}
+	return SequenceView(m_data + offset, length);
+}
+
+inline int MappedFileStream::get_char()
+{
+	int ch = peek();
+	if (ch != EOF)
+	{
+		++m_pos;
+	}
+	return ch;
+}
+
+inline int MappedFileStream::peek()
+{
+	if (!ensure_mapped(m_pos + 1))
+	{
+		m_eof = true;
+		return EOF;
+	}
+	return m_data[m_pos];
+}
+
+inline bool MappedFileStream::eof() const
+{
+	return m_eof;
+}
+
+inline void MappedFileStream::clear_error()
+{
+	m_eof = false;
+}
+
+inline std::streamoff MappedFileStream::tell() const
+{
+	return m_pos;
+}
+
+inline void MappedFileStream::seek(std::streamoff off, FileSeekWhence whence)
+{
+	switch (whence)
+	{
+		case FileSeekWhence::BEGIN:
+			m_pos = off;
+			break;
+		case FileSeekWhence::CURRENT:
+			m_pos += off;
+			break;
+		case FileSeekWhence::END:
+			m_pos = static_cast<std::streamoff>(size()) + off;
+			break;
+	}
+	m_eof = false;
+}
+
+inline std::size_t MappedFileStream::size()
+{
+	remap();
+	return m_mapped_size;
+}
+
+inline bool MappedFileStream::ensure_mapped(std::streamoff end)
+{
+	return end <= static_cast<std::streamoff>(m_mapped_size) || (remap() && end <= static_cast<std::streamoff>(m_mapped_size));
+}
+
 } // namespace lights
\ No newline at end of file
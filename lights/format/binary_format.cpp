@@ -33,6 +33,22 @@ inline BinaryTypeCode get_type_code(const char*)
 	return BinaryTypeCode::STRING;
 }
 
+/**
+ * Gets type code of float.
+ */
+inline BinaryTypeCode get_type_code(float)
+{
+	return BinaryTypeCode::FLOAT32;
+}
+
+/**
+ * Gets type code of double.
+ */
+inline BinaryTypeCode get_type_code(double)
+{
+	return BinaryTypeCode::FLOAT64;
+}
+
 /**
  * Get @c BinaryTypeCode by integer type @c T.
  */
@@ -79,6 +95,10 @@ inline std::uint8_t get_type_width(BinaryTypeCode code)
 		8, 8, // 64 bits
 		2,    // User-define composed type
 		4,    // String reference only store a string table index.
+		0, 0, // Varint width is decide by value.
+		4, 8, // Float and double.
+		0,    // Long string width is decide by length.
+		0,    // Integer spec width is decide by value.
 	};
 
 	std::uint8_t index = static_cast<std::uint8_t>(code);
@@ -93,7 +113,7 @@ inline std::uint8_t get_type_width(BinaryTypeCode code)
 }
 
 
-BinaryStoreWriter::BinaryStoreWriter(Sequence write_target, StringTable* str_table_ptr) :
+BinaryStoreWriter::BinaryStoreWriter(Sequence write_target, StringTable* str_table_ptr, BinaryIntegerEncoding integer_encoding) :
 	m_use_default_buffer(!is_valid(write_target)),
 	m_buffer(is_valid(write_target) ?
 			 static_cast<std::uint8_t*>(write_target.data()) :
@@ -102,7 +122,10 @@ BinaryStoreWriter::BinaryStoreWriter(Sequence write_target, StringTable* str_tab
 	m_capacity(is_valid(write_target) ? write_target.length() : WRITER_BUFFER_SIZE_DEFAULT),
 	m_state(FormatComposedTypeState::NO_INIT),
 	m_composed_member_num(0),
-	m_str_table_ptr(str_table_ptr)
+	m_str_table_ptr(str_table_ptr),
+	m_integer_encoding(integer_encoding),
+	m_overflow(false),
+	m_overflow_length(0)
 {}
 
 
@@ -137,6 +160,9 @@ BinaryStoreWriter& BinaryStoreWriter::operator=(const BinaryStoreWriter& rhs)
 		m_state = rhs.m_state;
 		m_composed_member_num = rhs.m_composed_member_num;
 		m_str_table_ptr = rhs.m_str_table_ptr;
+		m_integer_encoding = rhs.m_integer_encoding;
+		m_overflow = rhs.m_overflow;
+		m_overflow_length = rhs.m_overflow_length;
 	}
 	return *this;
 }
@@ -186,14 +212,29 @@ void BinaryStoreWriter::append(StringView str, bool store_in_table)
 			}
 		}
 		// Store string in buffer as other value.
-		else if (can_append(str.length() + sizeof(BinaryTypeCode) + sizeof(std::uint8_t)))
+		else if (str.length() <= std::numeric_limits<std::uint8_t>::max())
+		{
+			if (can_append(str.length() + sizeof(BinaryTypeCode) + sizeof(std::uint8_t)))
+			{
+				if (m_state == FormatComposedTypeState::STARTED)
+				{
+					++m_composed_member_num;
+				}
+				m_buffer[m_length++] = static_cast<std::uint8_t>(BinaryTypeCode::STRING);
+				m_buffer[m_length++] = static_cast<std::uint8_t>(str.length());
+				std::memcpy(m_buffer + m_length, str.data(), str.length());
+				m_length += str.length();
+			}
+		}
+		// Length of string cannot store in one byte.
+		else if (can_append(str.length() + sizeof(BinaryTypeCode) + details::varint_length(str.length())))
 		{
 			if (m_state == FormatComposedTypeState::STARTED)
 			{
 				++m_composed_member_num;
 			}
-			m_buffer[m_length++] = static_cast<std::uint8_t>(BinaryTypeCode::STRING);
-			m_buffer[m_length++] = static_cast<std::uint8_t>(str.length());
+			m_buffer[m_length++] = static_cast<std::uint8_t>(BinaryTypeCode::LONG_STRING);
+			m_length += details::encode_varint(str.length(), m_buffer + m_length);
 			std::memcpy(m_buffer + m_length, str.data(), str.length());
 			m_length += str.length();
 		}
@@ -201,9 +242,41 @@ void BinaryStoreWriter::append(StringView str, bool store_in_table)
 }
 
 
+bool BinaryStoreWriter::append_varint(BinaryTypeCode type_code, std::uint64_t n, std::size_t fixed_width)
+{
+	std::size_t length = details::varint_length(n);
+	if (length >= fixed_width)
+	{
+		return false;
+	}
+
+	if (can_append(sizeof(BinaryTypeCode) + length))
+	{
+		if (m_state == FormatComposedTypeState::STARTED)
+		{
+			++m_composed_member_num;
+		}
+		m_buffer[m_length++] = static_cast<std::uint8_t>(type_code);
+		m_length += details::encode_varint(n, m_buffer + m_length);
+	}
+	return true;
+}
+
+
+#define LIGHTSIMPL_BINARY_STORE_WRITER_APPEND_VARINT(Type)              \
+	(std::numeric_limits<Type>::is_signed ?                             \
+		append_varint(BinaryTypeCode::ZIGZAG_VARINT,                    \
+					  details::zigzag_encode(static_cast<std::int64_t>(n)), sizeof(Type)) : \
+		append_varint(BinaryTypeCode::VARINT, static_cast<std::uint64_t>(n), sizeof(Type)))
+
 #define LIGHTSIMPL_BINARY_STORE_WRITER_APPEND_INTEGER_BODY(Type)        \
 	{                                                                   \
 		BinaryTypeCode type_code = get_type_code(n);                    \
+		if (m_integer_encoding == BinaryIntegerEncoding::VARINT &&      \
+			LIGHTSIMPL_BINARY_STORE_WRITER_APPEND_VARINT(Type))         \
+		{                                                               \
+			return *this;                                               \
+		}                                                               \
 		if (can_append(sizeof(BinaryTypeCode) + get_type_width(type_code))) \
 		{                                                               \
 			if (m_state == FormatComposedTypeState::STARTED)            \
@@ -273,6 +346,108 @@ LIGHTSIMPL_BINARY_STORE_WRITER_APPEND_UNSIGNED_INTEGER(std::uint64_t, std::uint3
 
 #undef LIGHTSIMPL_BINARY_STORE_WRITER_APPEND_INTEGER_BODY
 
+#undef LIGHTSIMPL_BINARY_STORE_WRITER_APPEND_VARINT
+
+
+/**
+ * Inserts raw value of floating point.
+ */
+#define LIGHTSIMPL_BINARY_STORE_WRITER_APPEND_FLOAT(Type)               \
+	BinaryStoreWriter& BinaryStoreWriter::operator<< (Type n)           \
+	{                                                                   \
+		BinaryTypeCode type_code = get_type_code(n);                    \
+		if (can_append(sizeof(BinaryTypeCode) + get_type_width(type_code))) \
+		{                                                               \
+			if (m_state == FormatComposedTypeState::STARTED)            \
+			{                                                           \
+				++m_composed_member_num;                                \
+			}                                                           \
+			m_buffer[m_length++] = static_cast<std::uint8_t>(type_code);\
+			std::memcpy(&m_buffer[m_length], &n, sizeof(n));            \
+			m_length += get_type_width(type_code);                      \
+		}                                                               \
+		return *this;                                                   \
+	}
+
+LIGHTSIMPL_BINARY_STORE_WRITER_APPEND_FLOAT(float)
+LIGHTSIMPL_BINARY_STORE_WRITER_APPEND_FLOAT(double)
+
+#undef LIGHTSIMPL_BINARY_STORE_WRITER_APPEND_FLOAT
+
+
+BinaryStoreWriter& BinaryStoreWriter::operator<< (IntegerFormatSpec<std::int64_t> spec)
+{
+	append_integer_spec(spec.tag, spec.width, spec.fill, true, details::zigzag_encode(spec.value));
+	return *this;
+}
+
+
+BinaryStoreWriter& BinaryStoreWriter::operator<< (IntegerFormatSpec<std::uint64_t> spec)
+{
+	append_integer_spec(spec.tag, spec.width, spec.fill, false, spec.value);
+	return *this;
+}
+
+
+void BinaryStoreWriter::append_integer_spec(FormatSpecTag tag, int width, char fill, bool is_signed, std::uint64_t value)
+{
+	std::uint64_t store_width = details::zigzag_encode(width);
+	std::size_t length = sizeof(BinaryTypeCode) + sizeof(std::uint8_t) + sizeof(char) +
+		details::varint_length(store_width) + details::varint_length(value);
+	if (can_append(length))
+	{
+		if (m_state == FormatComposedTypeState::STARTED)
+		{
+			++m_composed_member_num;
+		}
+		m_buffer[m_length++] = static_cast<std::uint8_t>(BinaryTypeCode::INTEGER_SPEC);
+		m_buffer[m_length++] = static_cast<std::uint8_t>(static_cast<std::uint8_t>(tag) | (is_signed ? 0x80 : 0));
+		m_buffer[m_length++] = static_cast<std::uint8_t>(fill);
+		m_length += details::encode_varint(store_width, m_buffer + m_length);
+		m_length += details::encode_varint(value, m_buffer + m_length);
+	}
+}
+
+
+BinaryFormatTemplate::BinaryFormatTemplate(StringView fmt)
+{
+	std::size_t begin = 0;
+	for (std::size_t i = 0; i + 1 < fmt.length(); ++i)
+	{
+		if (fmt[i] == '{' && fmt[i+1] == '}')
+		{
+			m_segments.emplace_back(fmt.data() + begin, i - begin);
+			begin = i + 2; // Skip "{}".
+			++i;
+		}
+	}
+	m_segments.emplace_back(fmt.data() + begin, fmt.length() - begin);
+}
+
+
+void BinaryRestoreWriter::write_binary(const BinaryFormatTemplate& fmt,
+									   const std::uint8_t* binary_store_args,
+									   std::size_t args_length)
+{
+	const std::vector<StringView>& segments = fmt.segments();
+	m_writer.append(segments[0]);
+	for (std::size_t i = 1; i < segments.size(); ++i)
+	{
+		// Placeholder that has no argument is keep as it is.
+		if (args_length == 0)
+		{
+			m_writer.append("{}");
+		}
+		else
+		{
+			auto width = write_argument(binary_store_args);
+			binary_store_args += width;
+			args_length -= width;
+		}
+		m_writer.append(segments[i]);
+	}
+}
+
 
 void BinaryRestoreWriter::write_binary(StringView fmt, const std::uint8_t* binary_store_args, std::size_t args_length)
 {
@@ -303,9 +478,9 @@ void BinaryRestoreWriter::write_binary(StringView fmt, const std::uint8_t* binar
 }
 
 
-std::uint8_t BinaryRestoreWriter::write_argument(const std::uint8_t* binary_store_args)
+std::size_t BinaryRestoreWriter::write_argument(const std::uint8_t* binary_store_args)
 {
-	auto width = get_type_width(static_cast<BinaryTypeCode>(*binary_store_args));
+	std::size_t width = get_type_width(static_cast<BinaryTypeCode>(*binary_store_args));
 	auto value_begin = binary_store_args + sizeof(BinaryTypeCode);
 	switch (static_cast<BinaryTypeCode>(*binary_store_args))
 	{
@@ -407,6 +582,65 @@ std::uint8_t BinaryRestoreWriter::write_argument(const std::uint8_t* binary_stor
 			}
 			break;
 		}
+		case BinaryTypeCode::VARINT:
+		{
+			std::uint64_t n;
+			width = details::decode_varint(value_begin, details::VARINT_MAX_LENGTH, n);
+			m_writer << n;
+			break;
+		}
+		case BinaryTypeCode::ZIGZAG_VARINT:
+		{
+			std::uint64_t n;
+			width = details::decode_varint(value_begin, details::VARINT_MAX_LENGTH, n);
+			m_writer << details::zigzag_decode(n);
+			break;
+		}
+		case BinaryTypeCode::FLOAT32:
+		{
+			float n;
+			std::memcpy(&n, value_begin, sizeof(n));
+			m_writer << n;
+			break;
+		}
+		case BinaryTypeCode::FLOAT64:
+		{
+			double n;
+			std::memcpy(&n, value_begin, sizeof(n));
+			m_writer << n;
+			break;
+		}
+		case BinaryTypeCode::LONG_STRING:
+		{
+			std::uint64_t length;
+			width = details::decode_varint(value_begin, details::VARINT_MAX_LENGTH, length);
+			m_writer.append({reinterpret_cast<const char*>(value_begin + width), static_cast<std::size_t>(length)});
+			width += static_cast<std::size_t>(length);
+			break;
+		}
+		case BinaryTypeCode::INTEGER_SPEC:
+		{
+			auto tag = static_cast<FormatSpecTag>(value_begin[0] & 0x7f);
+			bool is_signed = (value_begin[0] & 0x80) != 0;
+			char fill = static_cast<char>(value_begin[1]);
+			width = sizeof(std::uint8_t) + sizeof(char);
+			std::uint64_t spec_width;
+			std::uint64_t value;
+			width += details::decode_varint(value_begin + width, details::VARINT_MAX_LENGTH, spec_width);
+			width += details::decode_varint(value_begin + width, details::VARINT_MAX_LENGTH, value);
+			int restore_width = static_cast<int>(details::zigzag_decode(spec_width));
+			if (is_signed)
+			{
+				IntegerFormatSpec<std::int64_t> spec = { details::zigzag_decode(value), tag, restore_width, fill };
+				m_writer << spec;
+			}
+			else
+			{
+				IntegerFormatSpec<std::uint64_t> spec = { value, tag, restore_width, fill };
+				m_writer << spec;
+			}
+			break;
+		}
 		case BinaryTypeCode::MAX:
 			break;
 	}
@@ -414,6 +648,126 @@ std::uint8_t BinaryRestoreWriter::write_argument(const std::uint8_t* binary_stor
 }
 
 
+/**
+ * Scans an argument and appends index of STRING_REF argument into @c indexes.
+ * @return Width of argument. Returns zero when argument is incomplete or invalid.
+ */
+inline std::size_t scan_str_ref(const std::uint8_t* binary_store_args, std::size_t length, std::vector<std::uint32_t>& indexes)
+{
+	if (length < sizeof(BinaryTypeCode) ||
+		*binary_store_args == static_cast<std::uint8_t>(BinaryTypeCode::INVALID) ||
+		*binary_store_args >= static_cast<std::uint8_t>(BinaryTypeCode::MAX))
+	{
+		return 0;
+	}
+
+	auto type_code = static_cast<BinaryTypeCode>(*binary_store_args);
+	auto value_begin = binary_store_args + sizeof(BinaryTypeCode);
+	std::size_t value_length = length - sizeof(BinaryTypeCode);
+	std::size_t width = get_type_width(type_code);
+	switch (type_code)
+	{
+		case BinaryTypeCode::STRING:
+		{
+			if (value_length < width)
+			{
+				return 0;
+			}
+			width += value_begin[0];
+			break;
+		}
+		case BinaryTypeCode::COMPOSED_TYPE:
+		{
+			if (value_length < width)
+			{
+				return 0;
+			}
+			std::uint16_t member_num;
+			std::memcpy(&member_num, value_begin, sizeof(member_num));
+			for (std::size_t i = 0; i < member_num; ++i)
+			{
+				std::size_t member_width = scan_str_ref(value_begin + width, value_length - width, indexes);
+				if (member_width == 0)
+				{
+					return 0;
+				}
+				width += member_width;
+			}
+			break;
+		}
+		case BinaryTypeCode::STRING_REF:
+		{
+			if (value_length < width)
+			{
+				return 0;
+			}
+			std::uint32_t index;
+			std::memcpy(&index, value_begin, sizeof(index));
+			indexes.push_back(index);
+			break;
+		}
+		case BinaryTypeCode::VARINT:
+		case BinaryTypeCode::ZIGZAG_VARINT:
+		{
+			std::uint64_t n;
+			width = details::decode_varint(value_begin, value_length, n);
+			if (width == 0)
+			{
+				return 0;
+			}
+			break;
+		}
+		case BinaryTypeCode::LONG_STRING:
+		{
+			std::uint64_t str_length;
+			width = details::decode_varint(value_begin, value_length, str_length);
+			if (width == 0 || str_length > value_length - width)
+			{
+				return 0;
+			}
+			width += static_cast<std::size_t>(str_length);
+			break;
+		}
+		case BinaryTypeCode::INTEGER_SPEC:
+		{
+			width = sizeof(std::uint8_t) + sizeof(char);
+			for (int i = 0; i < 2; ++i) // Width and value of spec.
+			{
+				std::uint64_t n;
+				std::size_t n_width = (value_length > width) ?
+					details::decode_varint(value_begin + width, value_length - width, n) : 0;
+				if (n_width == 0)
+				{
+					return 0;
+				}
+				width += n_width;
+			}
+			break;
+		}
+		default:
+			break;
+	}
+	return (width <= value_length) ? width + sizeof(BinaryTypeCode) : 0;
+}
+
+
+void get_str_ref_indexes(SequenceView binary_store_args, std::vector<std::uint32_t>& indexes)
+{
+	auto args = static_cast<const std::uint8_t*>(binary_store_args.data());
+	std::size_t length = binary_store_args.length();
+	while (length != 0)
+	{
+		std::size_t width = scan_str_ref(args, length, indexes);
+		if (width == 0)
+		{
+			break;
+		}
+		args += width;
+		length -= width;
+	}
+}
+
+
 void FormatSink<BinaryStoreWriter>::append(std::size_t num, char ch)
 {
 	for (std::size_t i = 0; i < num; ++i)
@@ -8,6 +8,7 @@
 
 #include <cstdint>
 #include <limits>
+#include <vector>
 
 #include "../sequence.h"
 #include "../format.h"
@@ -19,6 +20,81 @@ namespace lights {
 class BinaryStoreWriter;
 
 
+namespace details {
+
+/**
+ * Max length of varint that encode from 64 bits integer.
+ */
+constexpr std::size_t VARINT_MAX_LENGTH = 10;
+
+/**
+ * Encodes @c n as LEB128 varint into @c buffer.
+ * @return Number of bytes that write into buffer.
+ * @note Must ensure buffer have @c VARINT_MAX_LENGTH bytes at least.
+ */
+inline std::size_t encode_varint(std::uint64_t n, std::uint8_t* buffer)
+{
+	std::size_t length = 0;
+	while (n >= 0x80)
+	{
+		buffer[length++] = static_cast<std::uint8_t>(n | 0x80);
+		n >>= 7;
+	}
+	buffer[length++] = static_cast<std::uint8_t>(n);
+	return length;
+}
+
+/**
+ * Decodes LEB128 varint from @c data.
+ * @return Number of bytes that read from data. Returns zero when varint is incomplete or invalid.
+ */
+inline std::size_t decode_varint(const std::uint8_t* data, std::size_t length, std::uint64_t& n)
+{
+	n = 0;
+	for (std::size_t i = 0; i < length && i < VARINT_MAX_LENGTH; ++i)
+	{
+		n |= static_cast<std::uint64_t>(data[i] & 0x7f) << (7 * i);
+		if ((data[i] & 0x80) == 0)
+		{
+			return i + 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Returns the length of varint that encode from @c n.
+ */
+inline std::size_t varint_length(std::uint64_t n)
+{
+	std::size_t length = 1;
+	while (n >= 0x80)
+	{
+		n >>= 7;
+		++length;
+	}
+	return length;
+}
+
+/**
+ * Maps signed integer to unsigned integer, so small negative number also can use short varint.
+ */
+inline std::uint64_t zigzag_encode(std::int64_t n)
+{
+	return (static_cast<std::uint64_t>(n) << 1) ^ static_cast<std::uint64_t>(n >> 63);
+}
+
+/**
+ * Restores signed integer that map by @c zigzag_encode.
+ */
+inline std::int64_t zigzag_decode(std::uint64_t n)
+{
+	return static_cast<std::int64_t>(n >> 1) ^ -static_cast<std::int64_t>(n & 1);
+}
+
+} // namespace details
+
+
 /**
  * Enum all type of binary format support.
  */
@@ -38,10 +114,26 @@ enum class BinaryTypeCode: std::uint8_t
 	UINT64_T = 11,
 	COMPOSED_TYPE  = 12,
 	STRING_REF = 13,
+	VARINT = 14,
+	ZIGZAG_VARINT = 15,
+	FLOAT32 = 16,
+	FLOAT64 = 17,
+	LONG_STRING = 18,
+	INTEGER_SPEC = 19,
 	MAX
 };
 
 
+/**
+ * Enum all encoding of integer that BinaryStoreWriter support.
+ */
+enum class BinaryIntegerEncoding: std::uint8_t
+{
+	FIXED_WIDTH, // Uses the smallest fixed width integer that can hold value.
+	VARINT,      // Uses LEB128 varint (zigzag for signed integer) when it's shorter than fixed width.
+};
+
+
 /**
  * BinaryStoreWriter use to store all format arguments and delay text format.
  * @note If the internal buffer is full will have no effect.
@@ -58,9 +150,12 @@ public:
 
 	/**
 	 * Creates binary store writer.
-	 * @param write_target If write target is not specify, will use default write target with default size.
+	 * @param write_target      If write target is not specify, will use default write target with default size.
+	 * @param integer_encoding  How to store integer.
 	 */
-	BinaryStoreWriter(Sequence write_target = invalid_sequence(), StringTable* str_table_ptr = nullptr);
+	BinaryStoreWriter(Sequence write_target = invalid_sequence(),
+					  StringTable* str_table_ptr = nullptr,
+					  BinaryIntegerEncoding integer_encoding = BinaryIntegerEncoding::FIXED_WIDTH);
 
 	/**
 	 * Copies binary store writer.
@@ -85,6 +180,7 @@ public:
 	/**
 	 * @note If the internal buffer is full will have no effect.
 	 *       If @c store_in_table is set but string table is not set will also have no effect.
+	 * @details String that longer than 255 is store as LONG_STRING with varint length.
 	 */
 	void append(StringView str, bool store_in_table = false);
 
@@ -95,6 +191,30 @@ public:
 
 #undef LIGHTSIMPL_BINARY_STORE_WRITER_INSERT_DECLARE
 
+	/**
+	 * Stores raw value of float and format it when restore.
+	 * @note If the internal buffer is full will have no effect.
+	 */
+	BinaryStoreWriter& operator<< (float n);
+
+	/**
+	 * Stores raw value of double and format it when restore.
+	 * @note If the internal buffer is full will have no effect.
+	 */
+	BinaryStoreWriter& operator<< (double n);
+
+	/**
+	 * Stores raw value of integer with format spec and format it when restore.
+	 * @note If the internal buffer is full will have no effect.
+	 */
+	BinaryStoreWriter& operator<< (IntegerFormatSpec<std::int64_t> spec);
+
+	/**
+	 * Stores raw value of integer with format spec and format it when restore.
+	 * @note If the internal buffer is full will have no effect.
+	 */
+	BinaryStoreWriter& operator<< (IntegerFormatSpec<std::uint64_t> spec);
+
 	/**
 	 * It's only for write format to call and easy to restore.
 	 * @note If the internal buffer is full will have no effect.
@@ -169,12 +289,46 @@ public:
 	 */
 	std::size_t capacity() const;
 
+	/**
+	 * Checks some content cannot append because of internal buffer is full.
+	 */
+	bool is_overflow() const;
+
+	/**
+	 * Returns length that format result requires, it's larger than length() when overflow.
+	 * So caller can prepare buffer that large enough before format again.
+	 * @note Content of composed type that cannot append its header is not include.
+	 */
+	std::size_t required_length() const;
+
+	/**
+	 * Returns how to store integer.
+	 */
+	BinaryIntegerEncoding integer_encoding() const;
+
+	/**
+	 * Sets how to store integer.
+	 */
+	void set_integer_encoding(BinaryIntegerEncoding integer_encoding);
+
 private:
 	/**
 	 * Checks can append new content.
 	 */
 	bool can_append(std::size_t len);
 
+	/**
+	 * Appends integer as varint when varint is shorter than @c fixed_width.
+	 * @return Returns false when varint is not shorter.
+	 */
+	bool append_varint(BinaryTypeCode type_code, std::uint64_t n, std::size_t fixed_width);
+
+	/**
+	 * Appends integer with format spec. Layout is tag with signed flag, fill, zigzag varint of width
+	 * and varint of value (zigzag varint when value is signed).
+	 */
+	void append_integer_spec(FormatSpecTag tag, int width, char fill, bool is_signed, std::uint64_t value);
+
 	bool m_use_default_buffer;
 	std::uint8_t* m_buffer;
 	std::size_t m_length;
@@ -182,6 +336,9 @@ private:
 	FormatComposedTypeState m_state;
 	std::uint16_t m_composed_member_num;
 	StringTable* m_str_table_ptr;
+	BinaryIntegerEncoding m_integer_encoding;
+	bool m_overflow;
+	std::size_t m_overflow_length;
 };
 
 
@@ -269,6 +426,57 @@ LIGHTSIMPL_ALL_INTEGER_FUNCTION(LIGHTSIMPL_BINARY_STORE_WRITER_TO_STRING)
 
 #undef LIGHTSIMPL_BINARY_STORE_WRITER_TO_STRING
 
+/**
+ * Uses @c BinaryStoreWriter member function to store float and avoid format it.
+ */
+inline void to_string(FormatSink<BinaryStoreWriter> sink, float n)
+{
+	sink.get_internal_backend() << n;
+}
+
+/**
+ * Uses @c BinaryStoreWriter member function to store double and avoid format it.
+ */
+inline void to_string(FormatSink<BinaryStoreWriter> sink, double n)
+{
+	sink.get_internal_backend() << n;
+}
+
+/**
+ * Uses @c BinaryStoreWriter member function to store integer with format spec and avoid format it.
+ */
+template <typename Integer>
+inline void to_string(FormatSink<BinaryStoreWriter> sink, IntegerFormatSpec<Integer> spec)
+{
+	using Value = std::conditional_t<std::is_signed<Integer>::value, std::int64_t, std::uint64_t>;
+	IntegerFormatSpec<Value> store_spec = { static_cast<Value>(spec.value), spec.tag, spec.width, spec.fill };
+	sink.get_internal_backend() << store_spec;
+}
+
+
+/**
+ * BinaryFormatTemplate is format string that split into literal segments by placeholder "{}".
+ * Split format string once and use it to restore many times can avoid to scan format string
+ * every time.
+ * @note Template refers to content of format string, caller must ensure its lifecycle.
+ */
+class BinaryFormatTemplate
+{
+public:
+	/**
+	 * Splits @c fmt into segments.
+	 */
+	explicit BinaryFormatTemplate(StringView fmt);
+
+	/**
+	 * Returns the literal segments. There is a placeholder between every two adjacent segments.
+	 */
+	const std::vector<StringView>& segments() const;
+
+private:
+	std::vector<StringView> m_segments;
+};
+
 
 /**
  * BinaryRestoreWriter use to format text with arguments that store by @c BinaryStoreWriter.
@@ -308,6 +516,13 @@ public:
 	 */
 	void write_binary(StringView fmt, const std::uint8_t* binary_store_args, std::size_t args_length);
 
+	/**
+	 * Formats binary with the split format string. Result is same as format with the original
+	 * format string.
+	 * @note If the internal buffer is full will have no effect.
+	 */
+	void write_binary(const BinaryFormatTemplate& fmt, const std::uint8_t* binary_store_args, std::size_t args_length);
+
 	/**
 	 * Forwards to lights::operater<<() function.
 	 * @return The reference of this object.
@@ -365,13 +580,21 @@ private:
 	 * Writes a argument.
 	 * @return Width of argument.
 	 */
-	std::uint8_t write_argument(const uint8_t* binary_store_args);
+	std::size_t write_argument(const uint8_t* binary_store_args);
 
 	TextWriter m_writer;
 	StringTable* m_str_table_ptr;
 };
 
 
+/**
+ * Appends string table index of every STRING_REF argument that store by BinaryStoreWriter
+ * into @c indexes.
+ * @note Scanning stops at argument that is incomplete.
+ */
+void get_str_ref_indexes(SequenceView binary_store_args, std::vector<std::uint32_t>& indexes);
+
+
 // ========================= Implement. ==============================
 
 template <typename Arg, typename ... Args>
@@ -397,15 +620,27 @@ void BinaryStoreWriter::add_composed_type(const T& value)
 	}
 	else
 	{
+		const auto composed_header_len = sizeof(BinaryTypeCode) + sizeof(std::uint16_t) / sizeof(std::uint8_t);
+		if (!can_append(composed_header_len))
+		{
+			return;
+		}
+
 		m_composed_member_num = 0;
 		std::uint8_t* type = m_buffer + m_length;
 		auto composed_member_num = reinterpret_cast<std::uint16_t*>(m_buffer + m_length + sizeof(BinaryTypeCode));
-		const auto composed_header_len = sizeof(BinaryTypeCode) + sizeof(std::uint16_t) / sizeof(std::uint8_t);
 		m_length += composed_header_len;
+		std::size_t overflow_length = m_overflow_length;
 		m_state = FormatComposedTypeState::STARTED;
 		make_format_sink(*this) << value;
 		m_state = FormatComposedTypeState::ENDED;
 
+		// Header is remove below, but it's required when format again with a larger buffer.
+		if (m_composed_member_num <= 1 && m_overflow_length != overflow_length)
+		{
+			m_overflow_length += composed_header_len;
+		}
+
 		if (m_composed_member_num > 1)
 		{
 			*type = static_cast<std::uint8_t>(BinaryTypeCode::COMPOSED_TYPE);
@@ -462,6 +697,8 @@ inline void BinaryStoreWriter::resize(std::size_t new_size)
 inline void BinaryStoreWriter::clear()
 {
 	m_length = 0;
+	m_overflow = false;
+	m_overflow_length = 0;
 }
 
 inline std::size_t BinaryStoreWriter::max_size() const
@@ -474,9 +711,35 @@ inline std::size_t BinaryStoreWriter::capacity() const
 	return m_capacity;
 }
 
+inline BinaryIntegerEncoding BinaryStoreWriter::integer_encoding() const
+{
+	return m_integer_encoding;
+}
+
+inline void BinaryStoreWriter::set_integer_encoding(BinaryIntegerEncoding integer_encoding)
+{
+	m_integer_encoding = integer_encoding;
+}
+
+inline bool BinaryStoreWriter::is_overflow() const
+{
+	return m_overflow;
+}
+
+inline std::size_t BinaryStoreWriter::required_length() const
+{
+	return m_length + m_overflow_length;
+}
+
 inline bool BinaryStoreWriter::can_append(std::size_t len)
 {
-	return m_length + len <= max_size();
+	if (m_length + len <= max_size())
+	{
+		return true;
+	}
+	m_overflow = true;
+	m_overflow_length += len;
+	return false;
 }
 
 
@@ -500,6 +763,12 @@ inline BinaryStoreWriter& FormatSink<BinaryStoreWriter>::get_internal_backend()
 }
 
 
+inline const std::vector<StringView>& BinaryFormatTemplate::segments() const
+{
+	return m_segments;
+}
+
+
 inline BinaryRestoreWriter::BinaryRestoreWriter(String write_target, StringTable* str_table_ptr) :
 	m_writer(write_target),
 	m_str_table_ptr(str_table_ptr)
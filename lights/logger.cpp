@@ -6,20 +6,356 @@
 
 #include "logger.h"
 
+#include <algorithm>
 #include <memory>
 
+#include <dirent.h>
+#include <sys/stat.h>
+
 #include "precise_time.h"
+#include "checksum.h"
 
 
 namespace lights {
 
+namespace details {
+
+/**
+ * Writes time, logger name and level in front of text log message.
+ */
+template <typename Writer>
+void write_text_signature(Writer& writer, const PreciseTime& time, StringView name, LogLevel level)
+{
+	writer << '[' << Timestamp(time.seconds) << '.';
+
+	auto millis = time.nanoseconds / 1000 / 1000;
+	writer << pad(static_cast<unsigned>(millis), '0', 3);
+	writer << "] [" << name << "] ";
+	writer << "[" << to_string(level) << "] ";
+}
+
+
+/**
+ * Writes source location at the end of text log message.
+ */
+template <typename Writer>
+void write_text_location(Writer& writer, const SourceLocation& location)
+{
+	writer << " [" << location.file() << ':' << location.line() << "][" << location.function() << ']';
+}
+
+
+/**
+ * Appends separator of text log message. When writer is full, separator will overwrite
+ * the last characters of message.
+ * @param buffer  Internal buffer of writer.
+ */
+template <typename Writer>
+void append_log_separator(Writer& writer, char* buffer)
+{
+	StringView end_line = env::end_line();
+	writer.append(end_line);
+	if (writer.size() == writer.max_size())
+	{
+		char* last_char = &buffer[writer.size() - end_line.length()];
+		if (last_char != end_line)
+		{
+			copy_array(last_char, end_line.data(), end_line.length());
+		}
+	}
+}
+
+
+/**
+ * Prefix of call site in string table.
+ */
+constexpr char BINARY_CALL_SITE_PREFIX[] = "lights.call_site:";
+constexpr std::size_t BINARY_CALL_SITE_PREFIX_LENGTH = sizeof(BINARY_CALL_SITE_PREFIX) - 1;
+
+/**
+ * Converts call site to string that can be put into string table.
+ */
+std::string to_call_site_str(const BinaryCallSite& call_site)
+{
+	return format("{}{}:{}:{}:{}:{}:{}",
+				  BINARY_CALL_SITE_PREFIX,
+				  call_site.file_id,
+				  call_site.function_id,
+				  call_site.source_line,
+				  call_site.description_id,
+				  call_site.logger_id,
+				  static_cast<unsigned>(call_site.level));
+}
+
+
+/**
+ * Parses call site from string that convert by @c to_call_site_str.
+ * @return Returns false when string is not a call site.
+ */
+bool parse_call_site_str(StringView str, BinaryCallSite& call_site)
+{
+	if (str.length() < BINARY_CALL_SITE_PREFIX_LENGTH ||
+		std::memcmp(str.data(), BINARY_CALL_SITE_PREFIX, BINARY_CALL_SITE_PREFIX_LENGTH) != 0)
+	{
+		return false;
+	}
+
+	std::uint32_t fields[6];
+	std::size_t pos = BINARY_CALL_SITE_PREFIX_LENGTH;
+	for (std::size_t i = 0; i < size_of_array(fields); ++i)
+	{
+		if (i != 0)
+		{
+			if (pos >= str.length() || str.data()[pos] != ':')
+			{
+				return false;
+			}
+			++pos;
+		}
+
+		std::size_t start = pos;
+		std::uint32_t value = 0;
+		while (pos < str.length() && str.data()[pos] >= '0' && str.data()[pos] <= '9')
+		{
+			value = value * 10 + static_cast<std::uint32_t>(str.data()[pos] - '0');
+			++pos;
+		}
+		if (pos == start)
+		{
+			return false;
+		}
+		fields[i] = value;
+	}
+
+	call_site.file_id = fields[0];
+	call_site.function_id = fields[1];
+	call_site.source_line = fields[2];
+	call_site.description_id = fields[3];
+	call_site.logger_id = fields[4];
+	call_site.level = static_cast<LogLevel>(fields[5]);
+	return pos == str.length();
+}
+
+
+/**
+ * Converts time to nanoseconds since epoch.
+ */
+inline std::int64_t to_nanoseconds(std::int64_t seconds, std::int64_t nanoseconds)
+{
+	return seconds * PreciseTime::NANOSECONDS_OF_SECOND + nanoseconds;
+}
+
+
+/**
+ * Encodes @c n as varint with reverse byte order, so it can be read from back to front.
+ * @return Number of bytes that write into buffer.
+ */
+std::size_t encode_reverse_varint(std::uint64_t n, std::uint8_t* buffer)
+{
+	std::size_t length = encode_varint(n, buffer);
+	std::reverse(buffer, buffer + length);
+	return length;
+}
+
+
+/**
+ * Reads varint from file.
+ * @return Returns false when varint is incomplete or invalid.
+ */
+template <typename File>
+bool read_varint(File& file, std::uint64_t& n)
+{
+	n = 0;
+	for (std::size_t i = 0; i < VARINT_MAX_LENGTH; ++i)
+	{
+		int byte = file.get_char();
+		if (byte == EOF)
+		{
+			return false;
+		}
+
+		n |= static_cast<std::uint64_t>(byte & 0x7f) << (7 * i);
+		if ((byte & 0x80) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+
+/**
+ * Length of checksum of record in file of version 4.
+ */
+constexpr std::size_t BINARY_LOG_CHECKSUM_LENGTH = sizeof(std::uint32_t);
+
+/**
+ * Min length of block end record. It's the length of control record that only has block end.
+ */
+constexpr std::size_t BINARY_LOG_BLOCK_END_MIN_LENGTH = 2 + 1 + sizeof(BinaryLogBlockEnd) + BINARY_LOG_CHECKSUM_LENGTH + 1;
+
+/**
+ * Min length of padding record that has no payload.
+ */
+constexpr std::size_t BINARY_LOG_PADDING_MIN_LENGTH = 2 + 1 + BINARY_LOG_CHECKSUM_LENGTH + 1;
+
+
+/**
+ * Reads block header that place at @c offset.
+ * @param has_checksum  Checks checksum of block header record when it's true.
+ * @return Returns false when there is not header of @c block_index.
+ */
+template <typename File>
+bool read_block_header(File& file,
+					   std::streamoff offset,
+					   std::uint64_t block_index,
+					   BinaryLogBlockHeader& header,
+					   bool has_checksum)
+{
+	file.clear_error();
+	file.seek(offset, FileSeekWhence::BEGIN);
+	std::uint64_t payload_length;
+	if (file.get_char() != 0 ||
+		file.get_char() != BINARY_LOG_CONTROL_BLOCK ||
+		!read_varint(file, payload_length) ||
+		payload_length < sizeof(header) ||
+		file.read(Sequence(&header, sizeof(header))) != sizeof(header))
+	{
+		file.clear_error();
+		return false;
+	}
+
+	if (has_checksum)
+	{
+		std::uint8_t head[2 + VARINT_MAX_LENGTH] = {0, BINARY_LOG_CONTROL_BLOCK};
+		std::size_t head_length = 2 + encode_varint(payload_length, head + 2);
+		std::uint32_t checksum;
+		if (payload_length != sizeof(header) ||
+			file.read(Sequence(&checksum, sizeof(checksum))) != sizeof(checksum) ||
+			crc32c(SequenceView(&header, sizeof(header)), crc32c(SequenceView(head, head_length))) != checksum)
+		{
+			file.clear_error();
+			return false;
+		}
+	}
+	return header.block_index == block_index;
+}
+
+
+/**
+ * Skips a record in file of version 4 and sums up time of log message.
+ * @return Returns false when record is incomplete or corrupt.
+ */
+bool skip_block_record(FileStream& file, std::size_t file_size, std::int64_t& time, bool& is_message)
+{
+	std::streamoff begin = file.tell();
+	std::int64_t record_time = time;
+	std::uint64_t call_site_head;
+	std::uint64_t length;
+	std::streamoff content_begin;
+	if (!read_varint(file, call_site_head))
+	{
+		return false;
+	}
+
+	if (call_site_head == 0)
+	{
+		int type = file.get_char();
+		if (type == EOF || !read_varint(file, length))
+		{
+			return false;
+		}
+
+		content_begin = file.tell();
+		BinaryLogBlockHeader header;
+		if (type == BINARY_LOG_CONTROL_BLOCK && length >= sizeof(header))
+		{
+			if (file.read(Sequence(&header, sizeof(header))) != sizeof(header))
+			{
+				return false;
+			}
+			record_time = to_nanoseconds(header.time_seconds, header.time_nanoseconds);
+		}
+		is_message = false;
+	}
+	else
+	{
+		std::uint64_t time_delta;
+		if (!read_varint(file, time_delta) || !read_varint(file, length))
+		{
+			return false;
+		}
+		content_begin = file.tell();
+		record_time += zigzag_decode(time_delta);
+		is_message = true;
+	}
+
+	if (length > file_size)
+	{
+		return false;
+	}
+	std::streamoff checksum_begin = content_begin + static_cast<std::streamoff>(length);
+	std::streamoff end = checksum_begin + BINARY_LOG_CHECKSUM_LENGTH;
+	end += varint_length(static_cast<std::uint64_t>(end - begin));
+	if (end > static_cast<std::streamoff>(file_size))
+	{
+		return false;
+	}
+
+	// Record that is torn by crash may be follow by other content, so length is not enough.
+	std::vector<std::uint8_t> record(static_cast<std::size_t>(checksum_begin - begin));
+	std::uint32_t checksum;
+	file.seek(begin, FileSeekWhence::BEGIN);
+	if (file.read(Sequence(record.data(), record.size())) != record.size() ||
+		file.read(Sequence(&checksum, sizeof(checksum))) != sizeof(checksum) ||
+		crc32c(SequenceView(record.data(), record.size())) != checksum)
+	{
+		return false;
+	}
+	file.seek(end, FileSeekWhence::BEGIN);
+	time = record_time;
+	return true;
+}
+
+char* nested_log_buffer(std::size_t depth)
+{
+	thread_local std::vector<std::unique_ptr<char[]>> buffers;
+	std::size_t index = depth - 2;
+	if (buffers.size() <= index)
+	{
+		buffers.resize(index + 1);
+	}
+
+	if (!buffers[index])
+	{
+		buffers[index].reset(new char[LOG_BUFFER_SIZE]);
+	}
+	return buffers[index].get();
+}
+
+} // namespace details
+
+
+void LogCallSite::set_index(const StringTable& str_table, const LogCallSiteIndex& index)
+{
+	std::uint8_t expected = EMPTY;
+	if (!m_state.compare_exchange_strong(expected, FILLING, std::memory_order_acquire))
+	{
+		return;
+	}
+
+	m_str_table_id = str_table.id();
+	m_description = str_table.get_str(index.description_id);
+	m_index = index;
+	m_state.store(READY, std::memory_order_release);
+}
+
+
 TextLogger::TextLogger(StringView name, Sink& sink) :
 	m_name(name.data()),
 	m_level(LogLevel::INFO),
 	m_record_location(true),
-	m_sink(sink),
-	m_write_target(),
-	m_writer(make_string(m_write_target))
+	m_sink(sink)
 {}
 
 
@@ -27,12 +363,13 @@ void TextLogger::log(LogLevel level, const SourceLocation& location, const char*
 {
 	if (this->should_log(level))
 	{
-		m_writer.clear();
-		this->generate_signature(level);
-		m_writer.append(str);
-		this->record_location(location);
-		append_log_separator();
-		m_sink.write(m_writer.string_view());
+		details::LogBufferScope scope;
+		TextWriter writer(this->write_target());
+		this->generate_signature(writer, level);
+		writer.append(str);
+		this->record_location(writer, location);
+		this->append_log_separator(writer);
+		m_sink.write(writer.string_view());
 	}
 }
 
@@ -50,39 +387,116 @@ void TextLogger::log(LogLevel level, const SourceLocation& location, const char*
 //}
 
 
-void TextLogger::generate_signature(LogLevel level)
+void TextLogger::generate_signature(TextWriter& writer, LogLevel level)
 {
-	PreciseTime precise_time = current_precise_time();
-	m_writer << '[' << Timestamp(precise_time.seconds) << '.';
-
-	auto millis = precise_time.nanoseconds / 1000 / 1000;
-	m_writer << pad(static_cast<unsigned>(millis), '0', 3);
-	m_writer << "] [" << m_name << "] ";
-	m_writer << "[" << to_string(level) << "] ";
+	details::write_text_signature(writer, current_precise_time(), m_name, level);
 }
 
 
-void TextLogger::record_location(const SourceLocation& location)
+void TextLogger::record_location(TextWriter& writer, const SourceLocation& location)
 {
 	if (is_record_location() && is_valid(location))
 	{
-		m_writer.write(" [{}:{}][{}]", location.file(), location.line(), location.function());
+		details::write_text_location(writer, location);
 	}
 }
 
 
-void TextLogger::append_log_separator()
+void TextLogger::append_log_separator(TextWriter& writer)
 {
-	StringView end_line = env::end_line();
-	m_writer.append(end_line);
-	if (m_writer.size() == m_writer.max_size())
+	details::append_log_separator(writer, details::thread_log_buffer());
+}
+
+
+DeferredTextLogger::DeferredTextLogger(StringView name, sinks::AsyncSink& sink) :
+	m_name(name.data()),
+	m_level(LogLevel::INFO),
+	m_record_location(true),
+	m_sink(sink)
+{}
+
+
+DeferredTextLogger::~DeferredTextLogger()
+{
+	// Record reference to this logger, so must ensure all record is render.
+	m_sink.flush();
+}
+
+
+void DeferredTextLogger::log(LogLevel level, const SourceLocation& location, const char* str)
+{
+	if (this->should_log(level))
 	{
-		char* last_char = &m_write_target[m_writer.size() - end_line.length()];
-		if (last_char != end_line)
-		{
-			copy_array(last_char, end_line.data(), end_line.length());
-		}
+		details::LogBufferScope scope;
+		this->generate_signature(level, location, "");
+		Sequence target = this->write_target();
+		std::size_t length = std::min(std::strlen(str), target.length());
+		copy_array(static_cast<char*>(target.data()), str, length);
+		this->sink_msg(length);
+	}
+}
+
+
+void DeferredTextLogger::generate_signature(LogLevel level, const SourceLocation& location, StringView description)
+{
+	char* buffer = details::thread_log_buffer();
+	auto signature = reinterpret_cast<DeferredTextSignature*>(buffer);
+	auto time = current_precise_time();
+	signature->time_seconds = time.seconds;
+	signature->time_nanoseconds = time.nanoseconds;
+	signature->logger = this;
+	signature->file = location.file();
+	signature->function = location.function();
+	signature->source_line = location.line();
+	signature->level = level;
+	signature->record_location = is_record_location() && is_valid(location);
+
+	// Leaves half of buffer to arguments when description is too long.
+	std::size_t length = std::min(description.length(), details::LOG_BUFFER_SIZE / 2);
+	copy_array(buffer + sizeof(DeferredTextSignature), description.data(), length);
+	signature->description_length = static_cast<std::uint16_t>(length);
+}
+
+
+void DeferredTextLogger::sink_msg(std::size_t argument_length)
+{
+	char* buffer = details::thread_log_buffer();
+	auto signature = reinterpret_cast<DeferredTextSignature*>(buffer);
+	signature->argument_length = static_cast<std::uint16_t>(argument_length);
+	std::size_t length = sizeof(DeferredTextSignature) + signature->description_length + argument_length;
+	m_sink.write(SequenceView(buffer, length), &DeferredTextLogger::render);
+}
+
+
+void DeferredTextLogger::render(SequenceView record, Sink& backend)
+{
+	auto signature = &record.at<DeferredTextSignature>(0);
+	auto description = static_cast<const char*>(record.data()) + sizeof(DeferredTextSignature);
+	auto arguments = reinterpret_cast<const std::uint8_t*>(description) + signature->description_length;
+
+	// Use same size of TextLogger to generate same log message.
+	char buffer[WRITER_BUFFER_SIZE_DEFAULT];
+	BinaryRestoreWriter writer(make_string(buffer));
+
+	PreciseTime time(signature->time_seconds, signature->time_nanoseconds);
+	details::write_text_signature(writer, time, signature->logger->get_name(), signature->level);
+	if (signature->description_length == 0)
+	{
+		writer.append(StringView(reinterpret_cast<const char*>(arguments), signature->argument_length));
+	}
+	else
+	{
+		writer.write_binary(StringView(description, signature->description_length),
+							arguments, signature->argument_length);
+	}
+
+	if (signature->record_location)
+	{
+		SourceLocation location(signature->file, signature->source_line, signature->function);
+		details::write_text_location(writer, location);
 	}
+	details::append_log_separator(writer, buffer);
+	backend.write(writer.string_view());
 }
 
 
@@ -91,29 +505,59 @@ BinaryLogger::BinaryLogger(const std::string& name, Sink& sink, StringTable& str
 	m_level(LogLevel::INFO),
 	m_sink(sink),
 	m_str_table(str_table),
-	m_write_target(),
-	m_signature(reinterpret_cast<BinaryMessageSignature*>(m_write_target)),
-	m_writer(Sequence(m_write_target + sizeof(BinaryMessageSignature),
-					  sizeof(m_write_target) - sizeof(BinaryMessageSignature) - sizeof(std::uint16_t)),
-		// sizeof(std::uint16_t) is reverse for tail length.
-			 &m_str_table)
+	m_logger_id(static_cast<std::uint32_t>(str_table.get_index(name))),
+	m_integer_encoding(BinaryIntegerEncoding::FIXED_WIDTH)
+{}
+
+
+void BinaryLogger::generate_signature(BinaryMessageSignature& signature,
+									  LogLevel level,
+									  LogCallSite& call_site,
+									  const char* description)
 {
-	m_signature->logger_id = static_cast<std::uint32_t>(str_table.get_index(name));
+	auto time = current_precise_time();
+	signature.time_seconds = time.seconds;
+	signature.time_nanoseconds = time.nanoseconds;
+	const LogCallSiteIndex* cached_index = call_site.get_index(m_str_table, description);
+	if (cached_index != nullptr)
+	{
+		signature.file_id = cached_index->file_id;
+		signature.function_id = cached_index->function_id;
+		signature.description_id = cached_index->description_id;
+	}
+	else
+	{
+		LogCallSiteIndex index;
+		index.file_id = static_cast<std::uint32_t>(m_str_table.get_index(call_site.file()));
+		index.function_id = static_cast<std::uint32_t>(m_str_table.get_index(call_site.function()));
+		index.description_id = static_cast<std::uint32_t>(m_str_table.get_index(description));
+		call_site.set_index(m_str_table, index);
+		signature.file_id = index.file_id;
+		signature.function_id = index.function_id;
+		signature.description_id = index.description_id;
+	}
+	signature.source_line = call_site.line();
+	signature.logger_id = m_logger_id;
+	signature.level = level;
 }
 
 
-void BinaryLogger::generate_signature(LogLevel level, const SourceLocation& location, StringView description)
+void BinaryLogger::generate_signature(BinaryMessageSignature& signature,
+									  LogLevel level,
+									  const SourceLocation& location,
+									  StringView description)
 {
 	auto time = current_precise_time();
-	m_signature->time_seconds = time.seconds;
-	m_signature->time_nanoseconds = time.nanoseconds;
+	signature.time_seconds = time.seconds;
+	signature.time_nanoseconds = time.nanoseconds;
 	auto file_id = m_str_table.get_index(location.file());
-	m_signature->file_id = static_cast<std::uint32_t>(file_id);
+	signature.file_id = static_cast<std::uint32_t>(file_id);
 	auto function_id = m_str_table.get_index(location.function());
-	m_signature->function_id = static_cast<std::uint32_t>(function_id);
-	m_signature->source_line = location.line();
-	m_signature->description_id = static_cast<std::uint32_t>(m_str_table.get_index(description));
-	m_signature->level = level;
+	signature.function_id = static_cast<std::uint32_t>(function_id);
+	signature.source_line = location.line();
+	signature.description_id = static_cast<std::uint32_t>(m_str_table.get_index(description));
+	signature.logger_id = m_logger_id;
+	signature.level = level;
 }
 
 
@@ -121,95 +565,1863 @@ void BinaryLogger::log(LogLevel level, const SourceLocation& location, const cha
 {
 	if (this->should_log(level))
 	{
-		this->generate_signature(level, location, str);
-		set_argument_length(0);
-		this->sink_msg();
+		BinaryMessageSignature signature;
+		this->generate_signature(signature, level, location, str);
+		this->sink_msg(signature, [](BinaryStoreWriter&) {});
 	}
 }
 
 
-BinaryLogReader::BinaryLogReader(StringView log_filename, StringTable& str_table) :
-	m_file(log_filename, "rb"),
-	m_str_table(str_table),
-	m_writer(make_string(m_write_target), &str_table)
+void BinaryLogger::log(LogLevel level, LogCallSite& call_site, const char* str)
 {
+	if (this->should_log(level))
+	{
+		BinaryMessageSignature signature;
+		this->generate_signature(signature, level, call_site, str);
+		this->sink_msg(signature, [](BinaryStoreWriter&) {});
+	}
 }
 
 
-StringView BinaryLogReader::read()
+void BinaryLogger::sink_msg(const BinaryMessageSignature& signature, Sequence buffer, const BinaryStoreWriter& writer)
 {
-	m_writer.clear();
-	auto len = m_file.read(Sequence(&m_signature, sizeof(BinaryMessageSignature)));
-	if (len != sizeof(BinaryMessageSignature))
+	auto begin = static_cast<std::uint8_t*>(buffer.data());
+	std::memcpy(begin, &signature, sizeof(signature));
+	auto msg_signature = reinterpret_cast<BinaryMessageSignature*>(begin);
+	std::uint8_t* arguments_end = begin + sizeof(signature) + writer.length();
+
+	if (writer.length() < details::BINARY_LARGE_ARGUMENT_LENGTH)
 	{
-		return invalid_string_view();
+		msg_signature->argument_length = static_cast<std::uint16_t>(writer.length());
+	}
+	else
+	{
+		// Large record moves arguments backward to place real argument length in front of it.
+		auto argument_length = static_cast<std::uint32_t>(writer.length());
+		msg_signature->argument_length = details::BINARY_LARGE_ARGUMENT_LENGTH;
+		std::memmove(begin + sizeof(signature) + sizeof(argument_length), begin + sizeof(signature), writer.length());
+		std::memcpy(begin + sizeof(signature), &argument_length, sizeof(argument_length));
+		arguments_end += sizeof(argument_length);
+		std::memcpy(arguments_end, &argument_length, sizeof(argument_length));
+		arguments_end += sizeof(argument_length);
 	}
+	std::memcpy(arguments_end, &msg_signature->argument_length, sizeof(std::uint16_t));
 
-	std::unique_ptr<std::uint8_t[]> arguments(new std::uint8_t[m_signature.argument_length]);
-	m_file.read(Sequence(arguments.get(), m_signature.argument_length));
-	std::uint16_t tail_length;
-	m_file.read(Sequence(&tail_length, sizeof(tail_length)));
+	// signature + content + tail length.
+	m_sink.write(SequenceView(begin, arguments_end + sizeof(std::uint16_t) - begin));
+}
 
-	m_writer.write_text("[{}.{}] [{}] [{}] ",
-						Timestamp(m_signature.time_seconds),
-						pad(m_signature.time_nanoseconds, '0', 10),
-						to_string(m_signature.level),
-						m_str_table.get_str(m_signature.logger_id));
 
-	m_writer.write_binary(m_str_table.get_str(m_signature.description_id),
-						  arguments.get(),
-						  m_signature.argument_length);
+BinaryLogFileFormat::BinaryLogFileFormat(StringTable& str_table) :
+	m_str_table(str_table),
+	m_last_time(0),
+	m_data_begin(0),
+	m_block_size(details::BINARY_LOG_BLOCK_SIZE),
+	m_file_offset(0),
+	m_block_data_begin(0),
+	m_record_ordinal(0),
+	m_block_record_count(0),
+	m_inline_str_table(false),
+	m_file_inline_str_table(false),
+	m_inline_str_written(),
+	m_inline_str_indexes(),
+	m_str_ref_indexes(),
+	m_inline_str_payload(),
+	m_call_site_ids()
+{}
 
-	m_writer.write_text("  [{}:{}] [{}]",
-						m_str_table.get_str(m_signature.file_id),
-						m_signature.source_line,
-						m_str_table.get_str(m_signature.function_id));
 
-	return m_writer.string_view();
-}
+bool BinaryLogFileFormat::begin_file(FileStream& file)
+{
+	if (m_str_table.flush_policy().flush_on_new_file)
+	{
+		m_str_table.flush();
+	}
 
+	BinaryLogFileHeader header;
+	copy_array(header.magic, details::BINARY_LOG_MAGIC, sizeof(header.magic));
+	header.version = details::BINARY_LOG_VERSION_CHECKSUM;
+	header.header_length = sizeof(BinaryLogFileHeader) + sizeof(BinaryLogTimeBase) + sizeof(std::uint32_t) * 2;
 
-void BinaryLogReader::jump(std::streamoff line)
-{
-	if (line == 0)
+	PreciseTime now = current_precise_time();
+	m_block_data_begin = 0;
+	m_inline_str_written.clear();
+	if (file.size() == 0)
 	{
-		return;
+		BinaryLogTimeBase time_base;
+		time_base.time_seconds = now.seconds;
+		time_base.time_nanoseconds = now.nanoseconds;
+		auto block_size = static_cast<std::uint32_t>(details::BINARY_LOG_BLOCK_SIZE);
+		std::uint32_t flags = m_inline_str_table ? details::BINARY_LOG_FLAG_INLINE_STR_TABLE : 0;
+		file.write(SequenceView(&header, sizeof(header)));
+		file.write(SequenceView(&time_base, sizeof(time_base)));
+		file.write(SequenceView(&block_size, sizeof(block_size)));
+		file.write(SequenceView(&flags, sizeof(flags)));
+		m_file_inline_str_table = m_inline_str_table;
+		m_data_begin = header.header_length;
+		m_block_size = block_size;
+		m_file_offset = m_data_begin;
+		m_record_ordinal = 0;
+		this->begin_block(file, details::to_nanoseconds(now.seconds, now.nanoseconds));
+		return true;
 	}
-	else if (line > 0)
+
+	BinaryLogFileHeader exist_header;
+	BinaryLogTimeBase time_base;
+	std::uint32_t block_size = 0;
+	file.seek(0, FileSeekWhence::BEGIN);
+	if (file.read(Sequence(&exist_header, sizeof(exist_header))) != sizeof(exist_header) ||
+		std::memcmp(exist_header.magic, header.magic, sizeof(header.magic)) != 0 ||
+		exist_header.version != header.version ||
+		file.read(Sequence(&time_base, sizeof(time_base))) != sizeof(time_base) ||
+		file.read(Sequence(&block_size, sizeof(block_size))) != sizeof(block_size) ||
+		block_size == 0)
 	{
-		this->jump_from_head(static_cast<std::size_t>(line));
+		file.seek(0, FileSeekWhence::END);
+		return false;
 	}
-	else
+
+	// Flags is not exist in file that is written before flags is added.
+	std::uint32_t flags = 0;
+	if (exist_header.header_length >= header.header_length &&
+		file.read(Sequence(&flags, sizeof(flags))) != sizeof(flags))
 	{
-		this->jump_from_tail(static_cast<std::size_t>(0 - line));
+		flags = 0;
+	}
+
+	// Appends with the same mode of file. Strings are written again when they are used, because
+	// cannot know which strings are in file.
+	m_file_inline_str_table = (flags & details::BINARY_LOG_FLAG_INLINE_STR_TABLE) != 0;
+	m_data_begin = exist_header.header_length;
+	m_block_size = block_size;
+	bool complete = this->recover_block(file);
+	file.seek(0, FileSeekWhence::END);
+	m_file_offset = file.size();
+
+	// Starts with a new block when the last block is not finish writing.
+	if (!complete)
+	{
+		this->end_block(file);
+		this->begin_block(file, details::to_nanoseconds(now.seconds, now.nanoseconds));
 	}
+	return true;
 }
 
 
-void BinaryLogReader::jump_from_head(std::size_t line)
+std::size_t BinaryLogFileFormat::write(FileStream& file, SequenceView log_msg)
 {
-	for (std::size_t i = 0; i < line; ++i)
+	BinaryMessageSignature signature;
+	const std::uint8_t* arguments;
+	std::size_t argument_length;
+	this->parse_msg(log_msg, signature, arguments, argument_length);
+
+	std::size_t length = 0;
+	std::int64_t time = details::to_nanoseconds(signature.time_seconds, signature.time_nanoseconds);
+	std::uint32_t call_site_id = this->get_call_site_id(signature);
+	std::uint64_t call_site_head = call_site_id + std::uint64_t(1);
+
+	// Strings of log message and its call site string are added before it's write, so they are
+	// persisted not later than it.
+	m_str_table.flush_by_policy();
+	if (m_file_inline_str_table)
 	{
-		m_file.read({&m_signature, sizeof(BinaryMessageSignature)});
-		auto pos = m_file.tell();
-		pos += m_signature.argument_length + sizeof(std::uint16_t);
-		m_file.seek(pos, FileSeekWhence::BEGIN);
+		this->get_inline_str(signature, call_site_id, SequenceView(arguments, argument_length));
+		length += this->write_inline_str(file, time);
+	}
+
+	std::uint8_t head[details::VARINT_MAX_LENGTH * 3];
+	std::uint8_t tail[details::VARINT_MAX_LENGTH];
+	std::size_t head_length = 0;
+	std::size_t tail_length = 0;
+	auto encode_record = [&]() {
+		head_length = details::encode_varint(call_site_head, head);
+		head_length += details::encode_varint(details::zigzag_encode(time - m_last_time), head + head_length);
+		head_length += details::encode_varint(argument_length, head + head_length);
+		tail_length = details::encode_reverse_varint(head_length + argument_length + details::BINARY_LOG_CHECKSUM_LENGTH,
+													 tail);
+	};
+	encode_record();
+
+	// Log message that larger than block is write into a new block and cover the following blocks.
+	std::size_t record_length = head_length + argument_length + details::BINARY_LOG_CHECKSUM_LENGTH + tail_length;
+	if (!this->is_block_empty() &&
+		record_length + details::BINARY_LOG_BLOCK_END_MIN_LENGTH > this->remain_block_space())
+	{
+		length += this->end_block(file);
+		length += this->begin_block(file, time);
+		encode_record();
 	}
+
+	std::uint32_t checksum = crc32c(SequenceView(arguments, argument_length), crc32c(SequenceView(head, head_length)));
+	std::size_t record_write_length = file.write(SequenceView(head, head_length));
+	record_write_length += file.write(SequenceView(arguments, argument_length));
+	record_write_length += file.write(SequenceView(&checksum, sizeof(checksum)));
+	record_write_length += file.write(SequenceView(tail, tail_length));
+	m_file_offset += record_write_length;
+	m_last_time = time;
+	++m_record_ordinal;
+	++m_block_record_count;
+	return length + record_write_length;
 }
 
 
-void BinaryLogReader::jump_from_tail(std::size_t line)
+std::size_t BinaryLogFileFormat::max_write_length(SequenceView log_msg)
 {
-	m_file.seek(0, FileSeekWhence::END);
-	for (std::size_t i = 0; i < line; ++i)
+	BinaryMessageSignature signature;
+	const std::uint8_t* arguments;
+	std::size_t argument_length;
+	this->parse_msg(log_msg, signature, arguments, argument_length);
+
+	std::int64_t time = details::to_nanoseconds(signature.time_seconds, signature.time_nanoseconds);
+	std::uint32_t call_site_id = this->get_call_site_id(signature);
+	std::size_t block_header_length = control_length(sizeof(BinaryLogBlockHeader));
+	std::size_t length = 0;
+	std::size_t remain = this->remain_block_space();
+	bool block_empty = this->is_block_empty();
+
+	// Simulates write. Record that cannot put into block is written into a new block after
+	// block end fills the remaining space.
+	auto add_record = [&](std::size_t record_length) {
+		if (!block_empty && record_length + details::BINARY_LOG_BLOCK_END_MIN_LENGTH > remain)
+		{
+			std::size_t padding_length = remain;
+			if (remain < details::BINARY_LOG_BLOCK_END_MIN_LENGTH)
+			{
+				padding_length += m_block_size;
+			}
+			length += padding_length + block_header_length;
+			remain = m_block_size - block_header_length;
+		}
+		length += record_length;
+		remain = (record_length < remain) ? remain - record_length :
+			m_block_size - (record_length - remain) % m_block_size;
+		block_empty = false;
+	};
+
+	if (m_file_inline_str_table)
+	{
+		this->get_inline_str(signature, call_site_id, SequenceView(arguments, argument_length));
+		for (std::uint32_t str_index : m_inline_str_indexes)
+		{
+			std::size_t str_length = m_str_table.get_str(str_index).length();
+			add_record(control_length(details::varint_length(str_index) + str_length));
+		}
+	}
+
+	// Time delta is the largest before block begins.
+	std::size_t head_length = details::varint_length(call_site_id + std::uint64_t(1)) +
+		details::varint_length(details::zigzag_encode(time - m_last_time)) +
+		details::varint_length(argument_length);
+	std::size_t body_length = head_length + argument_length + details::BINARY_LOG_CHECKSUM_LENGTH;
+	add_record(body_length + details::varint_length(body_length));
+	return length;
+}
+
+
+void BinaryLogFileFormat::set_inline_str_table(bool enable)
+{
+	m_inline_str_table = enable;
+}
+
+
+std::uint32_t BinaryLogFileFormat::get_call_site_id(const BinaryMessageSignature& signature)
+{
+	details::BinaryCallSite call_site;
+	call_site.file_id = signature.file_id;
+	call_site.function_id = signature.function_id;
+	call_site.source_line = signature.source_line;
+	call_site.description_id = signature.description_id;
+	call_site.logger_id = signature.logger_id;
+	call_site.level = signature.level;
+
+	auto itr = m_call_site_ids.find(call_site);
+	if (itr != m_call_site_ids.end())
+	{
+		return itr->second;
+	}
+
+	std::string str = details::to_call_site_str(call_site);
+	auto call_site_id = static_cast<std::uint32_t>(m_str_table.get_index(StringView(str.c_str(), str.length())));
+	m_call_site_ids.insert(std::make_pair(call_site, call_site_id));
+	return call_site_id;
+}
+
+
+void BinaryLogFileFormat::parse_msg(SequenceView log_msg,
+									BinaryMessageSignature& signature,
+									const std::uint8_t*& arguments,
+									std::size_t& argument_length)
+{
+	if (log_msg.length() < sizeof(signature) + sizeof(std::uint16_t))
+	{
+		LIGHTS_THROW(InvalidArgument, "BinaryLogFileFormat: Log message is not write by BinaryLogger");
+	}
+
+	std::memcpy(&signature, log_msg.data(), sizeof(signature));
+	arguments = static_cast<const std::uint8_t*>(log_msg.data()) + sizeof(signature);
+	argument_length = signature.argument_length;
+	std::size_t expect_length = sizeof(signature) + argument_length + sizeof(std::uint16_t);
+	if (signature.argument_length == details::BINARY_LARGE_ARGUMENT_LENGTH &&
+		log_msg.length() >= sizeof(signature) + sizeof(std::uint32_t))
+	{
+		std::uint32_t large_length;
+		std::memcpy(&large_length, arguments, sizeof(large_length));
+		arguments += sizeof(large_length);
+		argument_length = large_length;
+		expect_length = sizeof(signature) + sizeof(large_length) * 2 + argument_length + sizeof(std::uint16_t);
+	}
+
+	if (expect_length != log_msg.length())
+	{
+		LIGHTS_THROW(InvalidArgument, "BinaryLogFileFormat: Log message is not write by BinaryLogger");
+	}
+}
+
+
+void BinaryLogFileFormat::get_inline_str(const BinaryMessageSignature& signature,
+										 std::uint32_t call_site_id,
+										 SequenceView arguments)
+{
+	// Reader gets logger, file, function and description by call site.
+	std::uint32_t used_indexes[] = {
+		call_site_id,
+		signature.logger_id,
+		signature.file_id,
+		signature.function_id,
+		signature.description_id
+	};
+	m_str_ref_indexes.clear();
+	get_str_ref_indexes(arguments, m_str_ref_indexes);
+
+	m_inline_str_indexes.clear();
+	auto add_index = [this](std::uint32_t str_index) {
+		bool written = str_index < m_inline_str_written.size() && m_inline_str_written[str_index];
+		if (!written &&
+			is_valid(m_str_table.get_str(str_index)) &&
+			std::find(m_inline_str_indexes.begin(), m_inline_str_indexes.end(), str_index) == m_inline_str_indexes.end())
+		{
+			m_inline_str_indexes.push_back(str_index);
+		}
+	};
+	for (std::uint32_t str_index : used_indexes)
+	{
+		add_index(str_index);
+	}
+	for (std::uint32_t str_index : m_str_ref_indexes)
+	{
+		add_index(str_index);
+	}
+}
+
+
+std::size_t BinaryLogFileFormat::write_inline_str(FileStream& file, std::int64_t time)
+{
+	std::size_t length = 0;
+	for (std::uint32_t str_index : m_inline_str_indexes)
+	{
+		StringView str = m_str_table.get_str(str_index);
+		if (str_index >= m_inline_str_written.size())
+		{
+			m_inline_str_written.resize(std::max<std::size_t>(str_index + 1, m_inline_str_written.size() * 2));
+		}
+		m_inline_str_written[str_index] = true;
+
+		std::uint8_t index[details::VARINT_MAX_LENGTH];
+		std::size_t index_length = details::encode_varint(str_index, index);
+		m_inline_str_payload.assign(reinterpret_cast<const char*>(index), index_length);
+		m_inline_str_payload.append(str.data(), str.length());
+
+		std::size_t payload_length = m_inline_str_payload.length();
+		std::size_t record_length = control_length(payload_length);
+		if (!this->is_block_empty() &&
+			record_length + details::BINARY_LOG_BLOCK_END_MIN_LENGTH > this->remain_block_space())
+		{
+			length += this->end_block(file);
+			length += this->begin_block(file, time);
+		}
+		length += this->write_control(file,
+									  details::BINARY_LOG_CONTROL_STRING,
+									  SequenceView(m_inline_str_payload.data(), payload_length));
+	}
+	return length;
+}
+
+
+bool BinaryLogFileFormat::recover_block(FileStream& file)
+{
+	m_record_ordinal = 0;
+	m_block_record_count = 0;
+	m_last_time = 0;
+
+	std::size_t file_size = file.size();
+	if (file_size <= m_data_begin)
+	{
+		return false;
+	}
+
+	std::size_t block_index = (file_size - m_data_begin) / m_block_size;
+	BinaryLogBlockHeader block_header;
+	while (!details::read_block_header(file, m_data_begin + block_index * m_block_size, block_index, block_header, true))
+	{
+		if (block_index == 0)
+		{
+			return false;
+		}
+		--block_index;
+	}
+
+	m_record_ordinal = block_header.first_record_ordinal;
+	file.seek(m_data_begin + block_index * m_block_size, FileSeekWhence::BEGIN);
+	bool is_message;
+	std::streamoff record_end = file.tell();
+	while (details::skip_block_record(file, file_size, m_last_time, is_message))
+	{
+		if (is_message)
+		{
+			++m_record_ordinal;
+			++m_block_record_count;
+		}
+		record_end = file.tell();
+	}
+
+	// Torn record is read to file end, so checks the end of the last complete record.
+	return record_end == static_cast<std::streamoff>(file_size);
+}
+
+
+std::size_t BinaryLogFileFormat::control_length(std::size_t payload_length)
+{
+	std::size_t body_length = 2 + details::varint_length(payload_length) + payload_length +
+		details::BINARY_LOG_CHECKSUM_LENGTH;
+	return body_length + details::varint_length(body_length);
+}
+
+
+std::size_t BinaryLogFileFormat::write_control(FileStream& file, std::uint8_t type, SequenceView payload)
+{
+	std::uint8_t head[2 + details::VARINT_MAX_LENGTH];
+	head[0] = 0; // Zero call site is control record.
+	head[1] = type;
+	std::size_t head_length = 2 + details::encode_varint(payload.length(), head + 2);
+
+	std::uint8_t tail[details::VARINT_MAX_LENGTH];
+	std::size_t tail_length = details::encode_reverse_varint(
+		head_length + payload.length() + details::BINARY_LOG_CHECKSUM_LENGTH, tail);
+
+	std::uint32_t checksum = crc32c(payload, crc32c(SequenceView(head, head_length)));
+	std::size_t length = file.write(SequenceView(head, head_length));
+	length += file.write(payload);
+	length += file.write(SequenceView(&checksum, sizeof(checksum)));
+	length += file.write(SequenceView(tail, tail_length));
+	m_file_offset += length;
+	return length;
+}
+
+
+std::size_t BinaryLogFileFormat::write_padding_control(FileStream& file,
+													   std::uint8_t type,
+													   SequenceView payload,
+													   std::size_t record_length)
+{
+	// Tries every combination of varint length, because varint length is affect by value.
+	for (std::size_t tail_length = 1; tail_length <= 3; ++tail_length)
+	{
+		for (std::size_t payload_varint_length = 1; payload_varint_length <= 3; ++payload_varint_length)
+		{
+			std::size_t fixed_length = 2 + payload_varint_length + details::BINARY_LOG_CHECKSUM_LENGTH + tail_length;
+			if (record_length < fixed_length + payload.length())
+			{
+				continue;
+			}
+
+			std::size_t payload_length = record_length - fixed_length;
+			if (details::varint_length(payload_length) != payload_varint_length ||
+				details::varint_length(record_length - tail_length) != tail_length)
+			{
+				continue;
+			}
+
+			std::uint8_t head[2 + details::VARINT_MAX_LENGTH];
+			head[0] = 0;
+			head[1] = type;
+			std::size_t head_length = 2 + details::encode_varint(payload_length, head + 2);
+			std::uint8_t tail[details::VARINT_MAX_LENGTH];
+			details::encode_reverse_varint(record_length - tail_length, tail);
+
+			static const std::uint8_t zeros[256] = {};
+			std::uint32_t checksum = crc32c(payload, crc32c(SequenceView(head, head_length)));
+			std::size_t length = file.write(SequenceView(head, head_length));
+			length += file.write(payload);
+			for (std::size_t remain = payload_length - payload.length(); remain > 0;)
+			{
+				std::size_t n = std::min(remain, sizeof(zeros));
+				checksum = crc32c(SequenceView(zeros, n), checksum);
+				length += file.write(SequenceView(zeros, n));
+				remain -= n;
+			}
+			length += file.write(SequenceView(&checksum, sizeof(checksum)));
+			length += file.write(SequenceView(tail, tail_length));
+			m_file_offset += length;
+			return length;
+		}
+	}
+	return 0;
+}
+
+
+std::size_t BinaryLogFileFormat::begin_block(FileStream& file, std::int64_t time)
+{
+	BinaryLogBlockHeader header;
+	header.block_index = (m_file_offset - m_data_begin) / m_block_size;
+	header.first_record_ordinal = m_record_ordinal;
+	header.time_seconds = time / PreciseTime::NANOSECONDS_OF_SECOND;
+	header.time_nanoseconds = time % PreciseTime::NANOSECONDS_OF_SECOND;
+	m_last_time = time;
+	m_block_record_count = 0;
+	std::size_t length = this->write_control(file, details::BINARY_LOG_CONTROL_BLOCK, SequenceView(&header, sizeof(header)));
+	m_block_data_begin = m_file_offset;
+	return length;
+}
+
+
+std::size_t BinaryLogFileFormat::end_block(FileStream& file)
+{
+	std::size_t remain = this->remain_block_space();
+	if (remain == m_block_size) // Already at block boundary.
+	{
+		return 0;
+	}
+	if (remain < details::BINARY_LOG_BLOCK_END_MIN_LENGTH)
+	{
+		remain += m_block_size;
+	}
+
+	BinaryLogBlockEnd block_end;
+	block_end.record_count = m_block_record_count;
+	block_end.last_time_seconds = m_last_time / PreciseTime::NANOSECONDS_OF_SECOND;
+	block_end.last_time_nanoseconds = m_last_time % PreciseTime::NANOSECONDS_OF_SECOND;
+
+	std::size_t length = 0;
+	while (true)
+	{
+		std::size_t n = this->write_padding_control(file,
+													details::BINARY_LOG_CONTROL_BLOCK_END,
+													SequenceView(&block_end, sizeof(block_end)),
+													remain - length);
+		if (n != 0)
+		{
+			return length + n;
+		}
+
+		// Some length cannot make a record because of varint length, so splits out a padding.
+		length += this->write_padding_control(file,
+											  details::BINARY_LOG_CONTROL_PADDING,
+											  SequenceView(nullptr, 0),
+											  details::BINARY_LOG_PADDING_MIN_LENGTH);
+	}
+}
+
+
+std::size_t BinaryLogFileFormat::remain_block_space() const
+{
+	return m_block_size - (m_file_offset - m_data_begin) % m_block_size;
+}
+
+
+bool BinaryLogFileFormat::is_block_empty() const
+{
+	return m_file_offset == m_block_data_begin;
+}
+
+
+BinaryLogFilter::BinaryLogFilter(StringTable& str_table) :
+	m_str_table(&str_table),
+	m_level(LogLevel::DEBUG),
+	m_logger(),
+	m_file(),
+	m_function(),
+	m_description(),
+	m_begin_time(std::numeric_limits<std::int64_t>::min()),
+	m_end_time(std::numeric_limits<std::int64_t>::max())
+{
+}
+
+
+void BinaryLogFilter::set_level(LogLevel level)
+{
+	m_level = level;
+}
+
+
+void BinaryLogFilter::set_logger(StringView pattern)
+{
+	m_logger.pattern = pattern.to_std_string();
+	m_logger.results.clear();
+}
+
+
+void BinaryLogFilter::set_file(StringView pattern)
+{
+	m_file.pattern = pattern.to_std_string();
+	m_file.results.clear();
+}
+
+
+void BinaryLogFilter::set_function(StringView pattern)
+{
+	m_function.pattern = pattern.to_std_string();
+	m_function.results.clear();
+}
+
+
+void BinaryLogFilter::set_description(StringView pattern)
+{
+	m_description.pattern = pattern.to_std_string();
+	m_description.results.clear();
+}
+
+
+void BinaryLogFilter::set_time_range(const PreciseTime& begin, const PreciseTime& end)
+{
+	m_begin_time = begin;
+	m_end_time = end;
+}
+
+
+void BinaryLogFilter::set_str_table(StringTable& str_table)
+{
+	m_str_table = &str_table;
+	m_logger.results.clear();
+	m_file.results.clear();
+	m_function.results.clear();
+	m_description.results.clear();
+}
+
+
+void BinaryLogFilter::clear_result(std::uint32_t id)
+{
+	m_logger.results.erase(id);
+	m_file.results.erase(id);
+	m_function.results.erase(id);
+	m_description.results.erase(id);
+}
+
+
+bool BinaryLogFilter::match(const BinaryMessageSignature& signature)
+{
+	if (signature.level < m_level)
+	{
+		return false;
+	}
+
+	PreciseTime time(signature.time_seconds, signature.time_nanoseconds);
+	if (time < m_begin_time || time > m_end_time)
+	{
+		return false;
+	}
+
+	return this->match(m_logger, signature.logger_id) &&
+		this->match(m_file, signature.file_id) &&
+		this->match(m_function, signature.function_id) &&
+		this->match(m_description, signature.description_id);
+}
+
+
+bool BinaryLogFilter::match(StringCondition& condition, std::uint32_t id)
+{
+	if (condition.pattern.empty())
+	{
+		return true;
+	}
+
+	auto itr = condition.results.find(id);
+	if (itr != condition.results.end())
+	{
+		return itr->second;
+	}
+
+	StringView str = m_str_table->get_str(id);
+	bool result = is_valid(str) &&
+		std::search(str.data(), str.data() + str.length(), condition.pattern.begin(), condition.pattern.end()) !=
+			str.data() + str.length();
+	condition.results.insert(std::make_pair(id, result));
+	return result;
+}
+
+
+BinaryLogReader::BinaryLogReader(StringView log_filename, StringTable& str_table) :
+	m_file(log_filename),
+	m_str_table(&str_table),
+	m_own_str_table(),
+	m_format_detected(false),
+	m_version(details::BINARY_LOG_VERSION_ORIGINAL),
+	m_data_begin(0),
+	m_block_size(0),
+	m_record_begin(0),
+	m_record_end(0),
+	m_inline_str_table(false),
+	m_inline_str_offset(0),
+	m_inline_str_replaced(false),
+	m_base_time(0),
+	m_last_time(0),
+	m_call_sites(),
+	m_format_templates(),
+	m_argument_length(0),
+	m_arguments(invalid_sequence_view()),
+	m_writer(make_string(m_write_target), &str_table),
+	m_large_write_target(),
+	m_filter(nullptr)
+{
+	m_file.advise(MappedFileAdvice::SEQUENTIAL);
+	this->detect_format();
+}
+
+
+bool BinaryLogReader::detect_format()
+{
+	if (m_format_detected)
+	{
+		return true;
+	}
+
+	// Cannot know the format until file header is write.
+	if (m_file.size() < sizeof(BinaryLogFileHeader))
+	{
+		return false;
+	}
+
+	BinaryLogFileHeader header;
+	m_file.seek(0, FileSeekWhence::BEGIN);
+	m_file.read(Sequence(&header, sizeof(header)));
+	if (std::memcmp(header.magic, details::BINARY_LOG_MAGIC, sizeof(header.magic)) != 0)
+	{
+		m_version = details::BINARY_LOG_VERSION_ORIGINAL;
+		m_data_begin = 0;
+	}
+	else if (header.version == details::BINARY_LOG_VERSION_CALL_SITE)
+	{
+		m_version = header.version;
+		m_data_begin = header.header_length;
+	}
+	else if (header.version >= details::BINARY_LOG_VERSION_VARINT && header.version <= details::BINARY_LOG_VERSION_CHECKSUM)
+	{
+		BinaryLogTimeBase time_base;
+		if (m_file.read(Sequence(&time_base, sizeof(time_base))) != sizeof(time_base))
+		{
+			m_file.seek(0, FileSeekWhence::BEGIN);
+			return false;
+		}
+		if (header.version >= details::BINARY_LOG_VERSION_BLOCK)
+		{
+			std::uint32_t block_size;
+			if (m_file.read(Sequence(&block_size, sizeof(block_size))) != sizeof(block_size))
+			{
+				m_file.seek(0, FileSeekWhence::BEGIN);
+				return false;
+			}
+			if (block_size == 0)
+			{
+				LIGHTS_THROW(InvalidArgument, "BinaryLogReader: Invalid block size");
+			}
+			m_block_size = block_size;
+		}
+
+		std::uint32_t flags = 0;
+		if (header.header_length >= sizeof(header) + sizeof(time_base) + sizeof(std::uint32_t) + sizeof(flags) &&
+			m_file.read(Sequence(&flags, sizeof(flags))) != sizeof(flags))
+		{
+			m_file.seek(0, FileSeekWhence::BEGIN);
+			return false;
+		}
+		m_inline_str_table = (flags & details::BINARY_LOG_FLAG_INLINE_STR_TABLE) != 0;
+		m_version = header.version;
+		m_data_begin = header.header_length;
+		m_base_time = details::to_nanoseconds(time_base.time_seconds, time_base.time_nanoseconds);
+		m_last_time = m_base_time;
+	}
+	else
+	{
+		LIGHTS_THROW(InvalidArgument, format("BinaryLogReader: Unsupported binary log version {}", header.version));
+	}
+
+	m_file.seek(m_data_begin, FileSeekWhence::BEGIN);
+	m_inline_str_offset = m_data_begin;
+	if (m_inline_str_table)
+	{
+		this->reset_inline_str_table();
+	}
+	m_format_detected = true;
+	return true;
+}
+
+
+bool BinaryLogReader::read_signature()
+{
+	if (!this->detect_format())
+	{
+		return false;
+	}
+
+	m_record_begin = m_file.tell();
+	if (m_version == details::BINARY_LOG_VERSION_ORIGINAL)
+	{
+		auto len = m_file.read(Sequence(&m_signature, sizeof(m_signature)));
+		if (len != sizeof(m_signature))
+		{
+			return false;
+		}
+		m_argument_length = m_signature.argument_length;
+		return this->read_large_argument_length();
+	}
+	else if (m_version == details::BINARY_LOG_VERSION_CALL_SITE)
+	{
+		BinaryCallSiteSignature signature;
+		auto len = m_file.read(Sequence(&signature, sizeof(signature)));
+		if (len != sizeof(signature))
+		{
+			return false;
+		}
+
+		const details::BinaryCallSite& call_site = this->get_call_site(signature.call_site_id);
+		m_signature.time_seconds = signature.time_seconds;
+		m_signature.time_nanoseconds = signature.time_nanoseconds;
+		m_signature.file_id = call_site.file_id;
+		m_signature.function_id = call_site.function_id;
+		m_signature.source_line = call_site.source_line;
+		m_signature.description_id = call_site.description_id;
+		m_signature.logger_id = call_site.logger_id;
+		m_signature.argument_length = signature.argument_length;
+		m_signature.level = call_site.level;
+		m_argument_length = signature.argument_length;
+		return this->read_large_argument_length();
+	}
+
+	while (true)
+	{
+		RecordType type = this->read_varint_record();
+		if (type == MESSAGE_RECORD)
+		{
+			return true;
+		}
+		else if (type == NO_RECORD)
+		{
+			return false;
+		}
+	}
+}
+
+
+BinaryLogReader::RecordType BinaryLogReader::read_varint_record()
+{
+	m_record_begin = m_file.tell();
+	if (m_version >= details::BINARY_LOG_VERSION_CHECKSUM)
+	{
+		if (!this->verify_record())
+		{
+			return this->resync() ? CORRUPT_RECORD : NO_RECORD;
+		}
+
+		if (m_inline_str_table && m_record_begin < m_inline_str_offset && m_inline_str_replaced)
+		{
+			this->reset_inline_str_table();
+		}
+		if (m_inline_str_table && m_record_begin > m_inline_str_offset)
+		{
+			this->load_inline_str(m_record_begin);
+		}
+		if (m_record_begin == m_inline_str_offset)
+		{
+			m_inline_str_offset = m_record_end;
+		}
+	}
+
+	std::uint64_t call_site_head;
+	if (!details::read_varint(m_file, call_site_head))
+	{
+		return NO_RECORD;
+	}
+
+	if (call_site_head == 0)
+	{
+		int type = m_file.get_char();
+		std::uint64_t payload_length;
+		if (type == EOF || !details::read_varint(m_file, payload_length))
+		{
+			return NO_RECORD;
+		}
+
+		std::streamoff payload_begin = m_file.tell();
+		if (type == details::BINARY_LOG_CONTROL_TIME_BASE && payload_length >= sizeof(BinaryLogTimeBase))
+		{
+			BinaryLogTimeBase time_base;
+			if (m_file.read(Sequence(&time_base, sizeof(time_base))) != sizeof(time_base))
+			{
+				return NO_RECORD;
+			}
+			m_last_time = details::to_nanoseconds(time_base.time_seconds, time_base.time_nanoseconds);
+		}
+		else if (type == details::BINARY_LOG_CONTROL_BLOCK && payload_length >= sizeof(BinaryLogBlockHeader))
+		{
+			BinaryLogBlockHeader block_header;
+			if (m_file.read(Sequence(&block_header, sizeof(block_header))) != sizeof(block_header))
+			{
+				return NO_RECORD;
+			}
+			m_last_time = details::to_nanoseconds(block_header.time_seconds, block_header.time_nanoseconds);
+		}
+		else if (type == details::BINARY_LOG_CONTROL_STRING && m_inline_str_table)
+		{
+			this->read_inline_str(static_cast<std::size_t>(payload_length));
+		}
+
+		// Skips the other control record.
+		m_file.seek(payload_begin + static_cast<std::streamoff>(payload_length), FileSeekWhence::BEGIN);
+		std::uint8_t tail[details::VARINT_MAX_LENGTH];
+		std::size_t length = this->tail_length();
+		if (m_file.read(Sequence(tail, length)) != length)
+		{
+			return NO_RECORD;
+		}
+		return CONTROL_RECORD;
+	}
+
+	std::uint64_t time_delta;
+	std::uint64_t argument_length;
+	if (!details::read_varint(m_file, time_delta) || !details::read_varint(m_file, argument_length))
+	{
+		return NO_RECORD;
+	}
+
+	const details::BinaryCallSite& call_site = this->get_call_site(static_cast<std::uint32_t>(call_site_head - 1));
+	m_last_time += details::zigzag_decode(time_delta);
+	m_signature.time_seconds = m_last_time / PreciseTime::NANOSECONDS_OF_SECOND;
+	m_signature.time_nanoseconds = m_last_time % PreciseTime::NANOSECONDS_OF_SECOND;
+	m_signature.file_id = call_site.file_id;
+	m_signature.function_id = call_site.function_id;
+	m_signature.source_line = call_site.source_line;
+	m_signature.description_id = call_site.description_id;
+	m_signature.logger_id = call_site.logger_id;
+	m_signature.argument_length = static_cast<std::uint16_t>(
+		std::min<std::uint64_t>(argument_length, details::BINARY_LARGE_ARGUMENT_LENGTH));
+	m_signature.level = call_site.level;
+	m_argument_length = static_cast<std::size_t>(argument_length);
+	return MESSAGE_RECORD;
+}
+
+
+bool BinaryLogReader::verify_record()
+{
+	std::uint64_t call_site_head;
+	std::uint64_t length;
+	if (!details::read_varint(m_file, call_site_head))
+	{
+		return false;
+	}
+
+	if (call_site_head == 0)
+	{
+		if (m_file.get_char() == EOF || !details::read_varint(m_file, length))
+		{
+			return false;
+		}
+	}
+	else
+	{
+		std::uint64_t time_delta;
+		if (!details::read_varint(m_file, time_delta) || !details::read_varint(m_file, length))
+		{
+			return false;
+		}
+	}
+
+	// Length of corrupt record is meaningless, so it's limit before use.
+	if (length > std::numeric_limits<std::uint32_t>::max())
+	{
+		return false;
+	}
+	std::size_t checksum_offset = static_cast<std::size_t>(m_file.tell() - m_record_begin + length);
+	SequenceView record = m_file.view(m_record_begin, checksum_offset + details::BINARY_LOG_CHECKSUM_LENGTH);
+	if (!is_valid(record))
+	{
+		return false;
+	}
+
+	std::uint32_t checksum;
+	std::memcpy(&checksum, static_cast<const std::uint8_t*>(record.data()) + checksum_offset, sizeof(checksum));
+	std::size_t tail_offset = checksum_offset + details::BINARY_LOG_CHECKSUM_LENGTH;
+	m_record_end = m_record_begin + static_cast<std::streamoff>(tail_offset + details::varint_length(tail_offset));
+	m_file.seek(m_record_begin, FileSeekWhence::BEGIN);
+	return crc32c(SequenceView(record.data(), checksum_offset)) == checksum;
+}
+
+
+bool BinaryLogReader::resync()
+{
+	// Incomplete record is writing when there is no block header after it.
+	std::size_t block_count = this->block_count();
+	std::size_t block_index = static_cast<std::size_t>((m_record_begin - m_data_begin) / m_block_size) + 1;
+	for (; block_index < block_count; ++block_index)
+	{
+		BinaryLogBlockHeader header;
+		if (details::read_block_header(m_file, this->block_offset(block_index), block_index, header, true))
+		{
+			m_file.seek(this->block_offset(block_index), FileSeekWhence::BEGIN);
+			return true;
+		}
+	}
+	m_file.seek(m_record_begin, FileSeekWhence::BEGIN);
+	return false;
+}
+
+
+void BinaryLogReader::read_inline_str(std::size_t payload_length)
+{
+	std::streamoff payload_end = m_file.tell() + static_cast<std::streamoff>(payload_length);
+	std::uint64_t index;
+	if (!details::read_varint(m_file, index) || m_file.tell() > payload_end)
+	{
+		return;
+	}
+
+	SequenceView str = m_file.view(m_file.tell(), static_cast<std::size_t>(payload_end - m_file.tell()));
+	if (!is_valid(str))
+	{
+		return;
+	}
+
+	// Appending process may have different string table, so the later string replaces.
+	auto str_index = static_cast<std::size_t>(index);
+	bool has_str = is_valid(m_str_table->get_str(str_index));
+	if (m_str_table->replace_str(str_index, StringView(static_cast<const char*>(str.data()), str.length())))
+	{
+		m_inline_str_replaced = m_inline_str_replaced || has_str;
+		auto id = static_cast<std::uint32_t>(index);
+		m_call_sites.erase(id);
+		m_format_templates.erase(id);
+		if (m_filter != nullptr)
+		{
+			m_filter->clear_result(id);
+		}
+	}
+}
+
+
+void BinaryLogReader::load_inline_str(std::streamoff end)
+{
+	std::streamoff record_begin = m_record_begin;
+	std::streamoff record_end = m_record_end;
+	m_file.seek(m_inline_str_offset, FileSeekWhence::BEGIN);
+	while (m_file.tell() < end)
+	{
+		m_record_begin = m_file.tell();
+		if (!this->verify_record())
+		{
+			if (!this->resync())
+			{
+				break;
+			}
+			continue;
+		}
+
+		std::uint64_t payload_length;
+		if (m_file.get_char() == 0 &&
+			m_file.get_char() == details::BINARY_LOG_CONTROL_STRING &&
+			details::read_varint(m_file, payload_length))
+		{
+			this->read_inline_str(static_cast<std::size_t>(payload_length));
+		}
+		m_file.seek(m_record_end, FileSeekWhence::BEGIN);
+	}
+
+	m_inline_str_offset = end;
+	m_record_begin = record_begin;
+	m_record_end = record_end;
+	m_file.seek(record_begin, FileSeekWhence::BEGIN);
+}
+
+
+void BinaryLogReader::reset_inline_str_table()
+{
+	m_own_str_table.reset(new StringTable());
+	this->set_str_table(*m_own_str_table);
+	m_inline_str_offset = m_data_begin;
+	m_inline_str_replaced = false;
+}
+
+
+void BinaryLogReader::set_str_table(StringTable& str_table)
+{
+	m_str_table = &str_table;
+	m_writer = BinaryRestoreWriter(make_string(m_write_target), m_str_table);
+	m_call_sites.clear();
+	m_format_templates.clear();
+	if (m_filter != nullptr)
+	{
+		m_filter->set_str_table(str_table);
+	}
+}
+
+
+std::size_t BinaryLogReader::tail_length()
+{
+	if (m_version >= details::BINARY_LOG_VERSION_CHECKSUM)
+	{
+		// Checksum is place in front of reverse varint and is count in its length.
+		std::streamoff length = m_file.tell() - m_record_begin + details::BINARY_LOG_CHECKSUM_LENGTH;
+		return details::BINARY_LOG_CHECKSUM_LENGTH + details::varint_length(static_cast<std::uint64_t>(length));
+	}
+	else if (m_version >= details::BINARY_LOG_VERSION_VARINT)
+	{
+		// Tail records the length of record that from record begin to current position.
+		return details::varint_length(static_cast<std::uint64_t>(m_file.tell() - m_record_begin));
+	}
+	else if (m_signature.argument_length == details::BINARY_LARGE_ARGUMENT_LENGTH)
+	{
+		return sizeof(std::uint32_t) + sizeof(std::uint16_t);
+	}
+	return sizeof(std::uint16_t);
+}
+
+
+bool BinaryLogReader::read_large_argument_length()
+{
+	if (m_signature.argument_length != details::BINARY_LARGE_ARGUMENT_LENGTH)
+	{
+		return true;
+	}
+
+	std::uint32_t argument_length;
+	if (m_file.read(Sequence(&argument_length, sizeof(argument_length))) != sizeof(argument_length))
+	{
+		return false;
+	}
+	m_argument_length = argument_length;
+	return true;
+}
+
+
+const details::BinaryCallSite& BinaryLogReader::get_call_site(std::uint32_t call_site_id)
+{
+	auto itr = m_call_sites.find(call_site_id);
+	if (itr != m_call_sites.end())
+	{
+		return itr->second;
+	}
+
+	details::BinaryCallSite call_site;
+	if (!details::parse_call_site_str(m_str_table->get_str(call_site_id), call_site))
+	{
+		LIGHTS_THROW(InvalidArgument, format("BinaryLogReader: Invalid call site id {}", call_site_id));
+	}
+	return m_call_sites.insert(std::make_pair(call_site_id, call_site)).first->second;
+}
+
+
+const BinaryFormatTemplate& BinaryLogReader::get_format_template(std::uint32_t description_id)
+{
+	auto itr = m_format_templates.find(description_id);
+	if (itr != m_format_templates.end())
+	{
+		return itr->second;
+	}
+
+	BinaryFormatTemplate format_template(m_str_table->get_str(description_id));
+	return m_format_templates.insert(std::make_pair(description_id, std::move(format_template))).first->second;
+}
+
+
+StringView BinaryLogReader::read()
+{
+	m_writer.clear();
+
+	// Incomplete log message may be writing, so goes back and reads it next time.
+	std::streamoff begin;
+	std::int64_t last_time;
+	auto rollback = [&]() {
+		m_file.seek(begin, FileSeekWhence::BEGIN);
+		m_last_time = last_time;
+		return invalid_string_view();
+	};
+
+	std::streamoff arguments_begin;
+	while (true)
+	{
+		begin = m_file.tell();
+		last_time = m_last_time;
+		if (!this->read_signature())
+		{
+			return rollback();
+		}
+
+		// Arguments is used in place of mapping. Reads tail before getting arguments, because
+		// reading may extend mapping and let the previous content invalid.
+		arguments_begin = m_file.tell();
+		m_file.seek(arguments_begin + static_cast<std::streamoff>(m_argument_length), FileSeekWhence::BEGIN);
+		std::uint8_t tail[sizeof(std::uint32_t) + details::VARINT_MAX_LENGTH];
+		std::size_t tail_length = this->tail_length();
+		if (m_file.read(Sequence(tail, tail_length)) != tail_length)
+		{
+			return rollback();
+		}
+
+		// Arguments of rejected log message is never decoded.
+		if (m_filter == nullptr || m_filter->match(m_signature))
+		{
+			break;
+		}
+	}
+
+	m_arguments = m_file.view(arguments_begin, m_argument_length);
+	if (!is_valid(m_arguments))
+	{
+		return rollback();
+	}
+
+	this->write_msg(m_writer);
+	if (m_writer.size() < m_writer.max_size())
+	{
+		return m_writer.string_view();
+	}
+
+	// Log message may be truncated, so writes it again with a larger buffer until it can hold.
+	std::size_t size = sizeof(m_write_target);
+	while (true)
+	{
+		size *= 2;
+		if (m_large_write_target.size() < size)
+		{
+			m_large_write_target.resize(size);
+		}
+		BinaryRestoreWriter writer(String(m_large_write_target.data(), size), m_str_table);
+		this->write_msg(writer);
+		if (writer.size() < writer.max_size())
+		{
+			return writer.string_view();
+		}
+	}
+}
+
+
+void BinaryLogReader::write_msg(BinaryRestoreWriter& writer)
+{
+	writer.write_text("[{}.{}] [{}] [{}] ",
+					  Timestamp(m_signature.time_seconds),
+					  pad(m_signature.time_nanoseconds, '0', 10),
+					  to_string(m_signature.level),
+					  m_str_table->get_str(m_signature.logger_id));
+
+	writer.write_binary(this->get_format_template(m_signature.description_id),
+						static_cast<const std::uint8_t*>(m_arguments.data()),
+						m_argument_length);
+
+	writer.write_text("  [{}:{}] [{}]",
+					  m_str_table->get_str(m_signature.file_id),
+					  m_signature.source_line,
+					  m_str_table->get_str(m_signature.function_id));
+}
+
+
+void BinaryLogReader::jump(std::streamoff line)
+{
+	if (line == 0)
+	{
+		return;
+	}
+	else if (line > 0)
+	{
+		this->jump_from_head(static_cast<std::size_t>(line));
+	}
+	else
+	{
+		this->jump_from_tail(static_cast<std::size_t>(0 - line));
+	}
+}
+
+
+void BinaryLogReader::jump_to_end()
+{
+	m_file.seek(0, FileSeekWhence::END);
+	if (this->detect_format() && m_version >= details::BINARY_LOG_VERSION_VARINT)
+	{
+		m_file.seek(0, FileSeekWhence::END);
+		this->restore_time(m_file.tell());
+	}
+}
+
+
+void BinaryLogReader::seek_time(const PreciseTime& time)
+{
+	std::int64_t target_time = details::to_nanoseconds(time.seconds, time.nanoseconds);
+	std::size_t block_count = this->block_count();
+	if (block_count != 0)
+	{
+		// Binary searches the last block that starts before time. Block header is a sparse time index.
+		std::size_t low = 0;
+		std::size_t high = block_count;
+		std::size_t found_index = 0;
+		while (low < high)
+		{
+			std::size_t middle = low + (high - low) / 2;
+			std::size_t block_index = middle;
+			BinaryLogBlockHeader header;
+			if (this->find_block(block_index, header) &&
+				details::to_nanoseconds(header.time_seconds, header.time_nanoseconds) < target_time)
+			{
+				found_index = block_index;
+				low = middle + 1;
+			}
+			else
+			{
+				high = middle;
+			}
+		}
+		m_file.seek(this->block_offset(found_index), FileSeekWhence::BEGIN);
+	}
+	else if (this->detect_format())
+	{
+		m_file.seek(m_data_begin, FileSeekWhence::BEGIN);
+		m_last_time = m_base_time;
+	}
+	else
+	{
+		return;
+	}
+
+	// Stops in front of the first log message that is not early than time.
+	while (true)
+	{
+		std::streamoff begin = m_file.tell();
+		std::int64_t last_time = m_last_time;
+		if (!this->read_signature() ||
+			details::to_nanoseconds(m_signature.time_seconds, m_signature.time_nanoseconds) >= target_time)
+		{
+			m_file.clear_error();
+			m_file.seek(begin, FileSeekWhence::BEGIN);
+			m_last_time = last_time;
+			break;
+		}
+		this->skip_content();
+	}
+}
+
+
+PreciseTime BinaryLogReader::message_time() const
+{
+	return PreciseTime(m_signature.time_seconds, m_signature.time_nanoseconds);
+}
+
+
+std::streamoff BinaryLogReader::message_offset() const
+{
+	return m_record_begin;
+}
+
+
+void BinaryLogReader::jump_to_block(std::size_t block_index)
+{
+	BinaryLogBlockHeader header;
+	if (this->block_count() != 0 && this->find_block(block_index, header))
+	{
+		m_file.seek(this->block_offset(block_index), FileSeekWhence::BEGIN);
+	}
+}
+
+
+bool BinaryLogReader::load_inline_str_table()
+{
+	if (!this->detect_format() || !m_inline_str_table)
+	{
+		return false;
+	}
+
+	this->load_inline_str(static_cast<std::streamoff>(m_file.size()));
+	return !m_inline_str_replaced;
+}
+
+
+void BinaryLogReader::share_inline_str_table(BinaryLogReader& reader)
+{
+	if (!this->detect_format())
+	{
+		return;
+	}
+
+	// Strings of the whole file are already in string table, so inline string table is skip.
+	m_inline_str_table = false;
+	this->set_str_table(*reader.m_str_table);
+	m_own_str_table.reset();
+}
+
+
+std::size_t BinaryLogReader::block_count()
+{
+	if (!this->detect_format() || m_version < details::BINARY_LOG_VERSION_BLOCK)
+	{
+		return 0;
+	}
+
+	std::size_t file_size = m_file.size();
+	if (file_size <= static_cast<std::size_t>(m_data_begin))
+	{
+		return 0;
+	}
+	return (file_size - m_data_begin + m_block_size - 1) / m_block_size;
+}
+
+
+void BinaryLogReader::jump_from_head(std::size_t line)
+{
+	if (this->block_count() != 0)
+	{
+		// Binary searches the last block that starts at or in front of line.
+		std::size_t low = 0;
+		std::size_t high = this->block_count();
+		std::size_t found_index = 0;
+		std::uint64_t found_ordinal = 0;
+		while (low < high)
+		{
+			std::size_t middle = low + (high - low) / 2;
+			std::size_t block_index = middle;
+			BinaryLogBlockHeader header;
+			if (this->find_block(block_index, header) && header.first_record_ordinal <= line)
+			{
+				found_index = block_index;
+				found_ordinal = header.first_record_ordinal;
+				low = middle + 1;
+			}
+			else
+			{
+				high = middle;
+			}
+		}
+
+		m_file.seek(this->block_offset(found_index), FileSeekWhence::BEGIN);
+		line -= static_cast<std::size_t>(found_ordinal);
+	}
+
+	for (std::size_t i = 0; i < line; ++i)
+	{
+		if (!this->read_signature())
+		{
+			break;
+		}
+		this->skip_content();
+	}
+}
+
+
+void BinaryLogReader::jump_from_tail(std::size_t line)
+{
+	std::size_t block_count = this->block_count();
+	if (block_count != 0)
+	{
+		// Counts log message from the last block to know the line number from head.
+		std::size_t block_index = block_count - 1;
+		BinaryLogBlockHeader header;
+		std::size_t message_num = 0;
+		if (this->find_block(block_index, header))
+		{
+			m_file.seek(this->block_offset(block_index), FileSeekWhence::BEGIN);
+			message_num = static_cast<std::size_t>(header.first_record_ordinal);
+			while (this->read_signature())
+			{
+				this->skip_content();
+				if (m_file.tell() > static_cast<std::streamoff>(m_file.size()))
+				{
+					break;
+				}
+				++message_num;
+			}
+			m_file.clear_error();
+		}
+		this->jump_from_head(message_num > line ? message_num - line : 0);
+		return;
+	}
+
+	this->detect_format();
+	m_file.seek(0, FileSeekWhence::END);
+	if (m_version == details::BINARY_LOG_VERSION_VARINT)
+	{
+		std::streamoff pos = m_file.tell();
+		std::size_t message_num = 0;
+		while (message_num < line && pos > m_data_begin)
+		{
+			pos = this->previous_record(pos);
+			m_file.seek(pos, FileSeekWhence::BEGIN);
+			if (m_file.get_char() != 0) // Is not control record.
+			{
+				++message_num;
+			}
+		}
+		this->restore_time(pos);
+		return;
+	}
+
+	for (std::size_t i = 0; i < line && m_file.tell() > m_data_begin; ++i)
 	{
 		std::uint16_t tail_length;
 		std::streamoff tail_length_pos = m_file.tell() - sizeof(tail_length);
 		m_file.seek(tail_length_pos, FileSeekWhence::BEGIN);
 		m_file.read(Sequence(&tail_length, sizeof(tail_length)));
-		std::streamoff previous_pos = m_file.tell() - (sizeof(BinaryMessageSignature) + tail_length + sizeof(tail_length));
+		std::streamoff record_length = this->signature_length() + tail_length + sizeof(tail_length);
+		if (tail_length == details::BINARY_LARGE_ARGUMENT_LENGTH)
+		{
+			std::uint32_t argument_length;
+			m_file.seek(tail_length_pos - sizeof(argument_length), FileSeekWhence::BEGIN);
+			m_file.read(Sequence(&argument_length, sizeof(argument_length)));
+			m_file.seek(tail_length_pos + sizeof(tail_length), FileSeekWhence::BEGIN);
+			record_length = this->signature_length() + sizeof(argument_length) * 2 + argument_length + sizeof(tail_length);
+		}
+		std::streamoff previous_pos = m_file.tell() - record_length;
 		m_file.seek(previous_pos, FileSeekWhence::BEGIN);
 	}
 }
 
+
+std::streamoff BinaryLogReader::previous_record(std::streamoff pos)
+{
+	// Tail is a reverse varint, so reads it from back to front.
+	std::uint64_t length = 0;
+	for (std::size_t i = 0; i < details::VARINT_MAX_LENGTH && pos > m_data_begin; ++i)
+	{
+		--pos;
+		m_file.seek(pos, FileSeekWhence::BEGIN);
+		int byte = m_file.get_char();
+		length |= static_cast<std::uint64_t>(byte & 0x7f) << (7 * i);
+		if ((byte & 0x80) == 0)
+		{
+			break;
+		}
+	}
+
+	std::streamoff previous_pos = pos - static_cast<std::streamoff>(length);
+	return (previous_pos < m_data_begin) ? m_data_begin : previous_pos;
+}
+
+
+void BinaryLogReader::restore_time(std::streamoff pos)
+{
+	// Finds the nearest time base in front of position and sums up time delta from it.
+	std::streamoff start = m_data_begin;
+	std::streamoff record_pos = pos;
+	if (m_version >= details::BINARY_LOG_VERSION_BLOCK)
+	{
+		// Block header is the time base.
+		std::size_t block_index = static_cast<std::size_t>((pos - m_data_begin) / m_block_size);
+		BinaryLogBlockHeader header;
+		if (this->find_block(block_index, header))
+		{
+			start = this->block_offset(block_index);
+		}
+		record_pos = m_data_begin; // Skips the backward search.
+	}
+
+	while (record_pos > m_data_begin)
+	{
+		record_pos = this->previous_record(record_pos);
+		m_file.seek(record_pos, FileSeekWhence::BEGIN);
+		if (m_file.get_char() == 0 && m_file.get_char() == details::BINARY_LOG_CONTROL_TIME_BASE)
+		{
+			start = record_pos;
+			break;
+		}
+	}
+
+	m_last_time = m_base_time;
+	m_file.seek(start, FileSeekWhence::BEGIN);
+	while (m_file.tell() < pos)
+	{
+		RecordType type = this->read_varint_record();
+		if (type == NO_RECORD)
+		{
+			break;
+		}
+		else if (type == MESSAGE_RECORD)
+		{
+			this->skip_content();
+		}
+	}
+	m_file.seek(pos, FileSeekWhence::BEGIN);
+}
+
+
+void BinaryLogReader::skip_content()
+{
+	m_file.seek(m_file.tell() + static_cast<std::streamoff>(m_argument_length), FileSeekWhence::BEGIN);
+	m_file.seek(m_file.tell() + static_cast<std::streamoff>(this->tail_length()), FileSeekWhence::BEGIN);
+}
+
+
+std::streamoff BinaryLogReader::block_offset(std::size_t block_index) const
+{
+	return m_data_begin + static_cast<std::streamoff>(block_index * m_block_size);
+}
+
+
+bool BinaryLogReader::find_block(std::size_t& block_index, BinaryLogBlockHeader& header)
+{
+	while (!details::read_block_header(m_file,
+									   this->block_offset(block_index),
+									   block_index,
+									   header,
+									   m_version >= details::BINARY_LOG_VERSION_CHECKSUM))
+	{
+		if (block_index == 0)
+		{
+			return false;
+		}
+		--block_index;
+	}
+	return true;
+}
+
+
+RotatingBinaryLogReader::RotatingBinaryLogReader(StringView name_format, StringTable& str_table) :
+	m_name_format(name_format.to_std_string()),
+	m_str_table(str_table),
+	m_filter(nullptr),
+	m_reader(),
+	m_filename(),
+	m_device(0),
+	m_inode(0)
+{
+}
+
+
+StringView RotatingBinaryLogReader::read()
+{
+	if (m_reader == nullptr)
+	{
+		std::vector<std::string> files = this->list_files();
+		if (files.empty())
+		{
+			return invalid_string_view();
+		}
+		this->open(files.front());
+	}
+
+	while (true)
+	{
+		StringView log = m_reader->read();
+		if (is_valid(log))
+		{
+			return log;
+		}
+
+		std::string successor = this->find_successor();
+		if (successor.empty())
+		{
+			return invalid_string_view();
+		}
+
+		// Sink closes the current file before creates successor, so the rest of current file
+		// must be read before switching. Otherwise log message that write after the last read
+		// is lost.
+		log = m_reader->read();
+		if (is_valid(log))
+		{
+			return log;
+		}
+		this->open(successor);
+	}
+}
+
+
+void RotatingBinaryLogReader::jump_to_end()
+{
+	std::vector<std::string> files = this->list_files();
+	if (!files.empty())
+	{
+		this->open(files.back());
+		m_reader->jump_to_end();
+	}
+}
+
+
+void RotatingBinaryLogReader::set_filter(BinaryLogFilter* filter)
+{
+	m_filter = filter;
+	if (m_reader != nullptr)
+	{
+		m_reader->set_filter(filter);
+	}
+}
+
+
+const std::string& RotatingBinaryLogReader::filename() const
+{
+	return m_filename;
+}
+
+
+std::vector<std::string> RotatingBinaryLogReader::list_files() const
+{
+	std::vector<std::string> files;
+	std::size_t placeholder_pos = m_name_format.find("{}");
+	if (placeholder_pos == std::string::npos)
+	{
+		if (env::file_exists(m_name_format.c_str()))
+		{
+			files.push_back(m_name_format);
+		}
+		return files;
+	}
+
+	std::size_t slash_pos = m_name_format.rfind('/', placeholder_pos);
+	std::string directory = (slash_pos == std::string::npos) ? "" : m_name_format.substr(0, slash_pos + 1);
+	std::string prefix = m_name_format.substr(directory.length(), placeholder_pos - directory.length());
+	std::string suffix = m_name_format.substr(placeholder_pos + 2);
+
+	// Pair of placeholder value and filename.
+	std::vector<std::pair<std::string, std::string>> entries;
+	DIR* dir = ::opendir(directory.empty() ? "." : directory.c_str());
+	if (dir == nullptr)
+	{
+		return files;
+	}
+	while (dirent* entry = ::readdir(dir))
+	{
+		std::string name = entry->d_name;
+		if (name.length() > prefix.length() + suffix.length() &&
+			name.compare(0, prefix.length(), prefix) == 0 &&
+			name.compare(name.length() - suffix.length(), suffix.length(), suffix) == 0)
+		{
+			std::string value = name.substr(prefix.length(), name.length() - prefix.length() - suffix.length());
+			entries.emplace_back(value, directory + name);
+		}
+	}
+	::closedir(dir);
+
+	auto is_number = [](const std::string& str) {
+		return std::all_of(str.begin(), str.end(), [](char ch) { return ch >= '0' && ch <= '9'; });
+	};
+	std::sort(entries.begin(), entries.end(), [&](const std::pair<std::string, std::string>& left,
+												  const std::pair<std::string, std::string>& right) {
+		if (is_number(left.first) && is_number(right.first) && left.first.length() != right.first.length())
+		{
+			return left.first.length() < right.first.length();
+		}
+		return left.first < right.first;
+	});
+
+	for (auto& entry : entries)
+	{
+		files.push_back(std::move(entry.second));
+	}
+	return files;
+}
+
+
+void RotatingBinaryLogReader::open(const std::string& filename)
+{
+	std::unique_ptr<BinaryLogReader> reader(new BinaryLogReader(filename, m_str_table));
+	reader->set_filter(m_filter);
+
+	struct stat file_stat;
+	if (::stat(filename.c_str(), &file_stat) == -1)
+	{
+		LIGHTS_THROW(OpenFileError, filename);
+	}
+	m_device = file_stat.st_dev;
+	m_inode = file_stat.st_ino;
+	m_reader = std::move(reader);
+	m_filename = filename;
+}
+
+
+std::string RotatingBinaryLogReader::find_successor() const
+{
+	std::vector<std::string> files = this->list_files();
+	for (std::size_t i = 0; i < files.size(); ++i)
+	{
+		struct stat file_stat;
+		if (::stat(files[i].c_str(), &file_stat) == 0 &&
+			file_stat.st_dev == m_device &&
+			file_stat.st_ino == m_inode)
+		{
+			return (i + 1 < files.size()) ? files[i + 1] : std::string();
+		}
+	}
+
+	// The current file is removed by rotating, so all rest files are after it.
+	return files.empty() ? std::string() : files.front();
+}
+
+
+BinaryLogMerger::BinaryLogMerger() :
+	m_readers(),
+	m_heap(),
+	m_started(false),
+	m_reader_index(0)
+{
+}
+
+
+void BinaryLogMerger::add_reader(BinaryLogReader& reader)
+{
+	LIGHTS_ASSERT(!m_started && "Cannot add reader after reading");
+	m_readers.push_back(&reader);
+}
+
+
+StringView BinaryLogMerger::read()
+{
+	// Log message is read lazily, because returned log message is belong to reader and will be
+	// overwritten by the next read of the same reader.
+	if (!m_started)
+	{
+		for (std::size_t i = 0; i < m_readers.size(); ++i)
+		{
+			this->fill_reader(i);
+		}
+		m_started = true;
+	}
+	else if (m_reader_index < m_readers.size())
+	{
+		this->fill_reader(m_reader_index);
+	}
+
+	if (m_heap.empty())
+	{
+		m_reader_index = m_readers.size();
+		return invalid_string_view();
+	}
+
+	PendingMessage message = m_heap.top();
+	m_heap.pop();
+	m_reader_index = message.reader_index;
+	return message.log;
+}
+
+
+std::size_t BinaryLogMerger::reader_index() const
+{
+	return m_reader_index;
+}
+
+
+bool BinaryLogMerger::LaterMessage::operator()(const PendingMessage& left, const PendingMessage& right) const
+{
+	if (left.time > right.time)
+	{
+		return true;
+	}
+	else if (left.time < right.time)
+	{
+		return false;
+	}
+	return left.reader_index > right.reader_index;
+}
+
+
+void BinaryLogMerger::fill_reader(std::size_t reader_index)
+{
+	BinaryLogReader& reader = *m_readers[reader_index];
+	StringView log = reader.read();
+	if (is_valid(log))
+	{
+		m_heap.push(PendingMessage{reader.message_time(), reader_index, log});
+	}
+}
+
 } // namespace lights
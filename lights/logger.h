@@ -9,13 +9,23 @@
 #include <cstring>
 #include <ctime>
 #include <string>
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <queue>
+#include <algorithm>
 
 #include "env.h"
 #include "format.h"
 #include "format/binary_format.h"
 #include "file.h"
 #include "exception.h"
+#include "non_copyable.h"
 #include "string_table.h"
+#include "precise_time.h"
+#include "sinks/async_sink.h"
+#include "sinks/file_sink.h"
 
 
 namespace lights {
@@ -26,6 +36,87 @@ static const StringView log_level_names[] = {
 	"debug", "info", "warning", "error", "off"
 };
 
+/**
+ * Size of format buffer that use by logger in every thread.
+ */
+constexpr std::size_t LOG_BUFFER_SIZE = WRITER_BUFFER_SIZE_LARGE;
+
+/**
+ * Max size of spill buffer that use to format log message that cannot hold by format buffer.
+ */
+constexpr std::size_t LOG_SPILL_BUFFER_MAX_SIZE = 16 * 1024 * 1024;
+
+/**
+ * Returns nesting depth of logging in current thread. Depth is 1 when log a message and
+ * is greater than 1 when log other message while formatting arguments of it.
+ */
+inline std::size_t& thread_log_depth()
+{
+	thread_local std::size_t depth = 0;
+	return depth;
+}
+
+/**
+ * LogBufferScope marks a log message is formatting in current thread, so nested logging
+ * that formats a message in the same thread uses format buffer of another depth.
+ */
+class LogBufferScope : public NonCopyable
+{
+public:
+	LogBufferScope()
+	{
+		++thread_log_depth();
+	}
+
+	~LogBufferScope()
+	{
+		--thread_log_depth();
+	}
+};
+
+/**
+ * Returns format buffer of nesting depth that greater than 1 in current thread.
+ */
+char* nested_log_buffer(std::size_t depth);
+
+/**
+ * Returns format buffer of current thread. All logger in the same thread share this buffer,
+ * so a logger can be use in multiple thread without lock and have no buffer of itself.
+ * @details Nested logging has its own buffer of depth and allocates it when first use,
+ *          so logging in outer message is not corrupted.
+ * @note Must be call within LogBufferScope.
+ */
+inline char* thread_log_buffer()
+{
+	thread_local char buffer[LOG_BUFFER_SIZE];
+	std::size_t depth = thread_log_depth();
+	return depth <= 1 ? buffer : nested_log_buffer(depth);
+}
+
+/**
+ * Returns spill buffer of nesting depth in current thread that at least has @c size bytes.
+ * Spill buffer only grows, so it allocates memory only when log message is larger than any
+ * message before.
+ * @note Content of buffer is not keep after grows.
+ */
+inline Sequence thread_spill_buffer(std::size_t size)
+{
+	thread_local std::vector<std::vector<char>> buffers;
+	std::size_t index = std::max<std::size_t>(thread_log_depth(), 1) - 1;
+	if (buffers.size() <= index)
+	{
+		buffers.resize(index + 1);
+	}
+
+	std::vector<char>& buffer = buffers[index];
+	if (buffer.size() < size)
+	{
+		buffer.clear();
+		buffer.resize(size);
+	}
+	return Sequence(buffer.data(), buffer.size());
+}
+
 } // namespace details
 
 
@@ -46,8 +137,65 @@ inline const StringView to_string(LogLevel level)
 }
 
 
+/**
+ * LogCallSiteIndex is string table index of log call site.
+ */
+struct LogCallSiteIndex
+{
+	std::uint32_t file_id;
+	std::uint32_t function_id;
+	std::uint32_t description_id;
+};
+
+
+/**
+ * LogCallSite is the source location of a log call and caches the string table index of it.
+ * @c LIGHTS_LOG creates a static call site for every log call, so BinaryLogger only resolves
+ * index at the first time and reuses it on every subsequent call.
+ * @details Only the first string table that use with call site is cached, other string table
+ *          still resolves index every time. Description is also checked before use cache,
+ *          so call site also can be use with a variable description.
+ */
+class LogCallSite : public SourceLocation
+{
+public:
+	/**
+	 * Creates call site.
+	 */
+	explicit LogCallSite(const SourceLocation& location);
+
+	/**
+	 * Gets cached index of @c str_table with @c description.
+	 * @return Returns nullptr when have no cache.
+	 */
+	const LogCallSiteIndex* get_index(const StringTable& str_table, const char* description) const;
+
+	/**
+	 * Caches index of @c str_table. Description is get from @c str_table by index.
+	 * @note Only the first cache is accepted.
+	 */
+	void set_index(const StringTable& str_table, const LogCallSiteIndex& index);
+
+private:
+	enum State: std::uint8_t
+	{
+		EMPTY,
+		FILLING,
+		READY,
+	};
+
+	std::atomic<std::uint8_t> m_state;
+	std::size_t m_str_table_id;
+	StringView m_description; // Reference to string in string table.
+	LogCallSiteIndex m_index;
+};
+
+
 /**
  * TextLogger log message with text mode to backend sink.
+ * @details Logger has no format buffer of itself (see details::thread_log_buffer), so logger
+ *          can be share with multiple thread. But backend sink must support to write in
+ *          multiple thread.
  */
 class TextLogger
 {
@@ -126,23 +274,147 @@ public:
 private:
 	bool should_log(LogLevel level) const;
 
-	void generate_signature(LogLevel level);
+	String write_target() const;
+
+	void generate_signature(TextWriter& writer, LogLevel level);
 
-	void record_location(const SourceLocation& location);
+	void record_location(TextWriter& writer, const SourceLocation& location);
 
-	void append_log_separator();
+	void append_log_separator(TextWriter& writer);
 
 	std::string m_name;
 	LogLevel m_level;
 	bool m_record_location;
 	Sink& m_sink;
-	char m_write_target[WRITER_BUFFER_SIZE_DEFAULT];
-	TextWriter m_writer;
+};
+
+
+class DeferredTextLogger;
+
+/**
+ * DeferredTextSignature is the header of record that DeferredTextLogger write to AsyncSink.
+ */
+struct DeferredTextSignature
+{
+public:
+	std::int64_t time_seconds;
+	std::int64_t time_nanoseconds;
+	const DeferredTextLogger* logger;
+	const char* file;
+	const char* function;
+	std::uint32_t source_line;
+	std::uint16_t description_length; // Arguments are plain text when description is empty.
+	std::uint16_t argument_length;
+	LogLevel level;
+	bool record_location;
+};
+
+
+/**
+ * DeferredTextLogger log message with the same text mode of TextLogger. But it only stores
+ * arguments with binary mode in caller thread, and formats text in the backend thread of AsyncSink.
+ * So the caller thread will not spend time to format time and integer.
+ * @details Logger can be share with multiple thread as TextLogger. Record is signature, format
+ *          string and arguments. Format string is copied into record, because it may be invalid
+ *          before record is render in backend thread.
+ */
+class DeferredTextLogger
+{
+public:
+	/**
+	 * Creates deferred text logger.
+	 * @note Caller must ensure lifecycle of `sink`.
+	 */
+	DeferredTextLogger(StringView name, sinks::AsyncSink& sink);
+
+	/**
+	 * Waits until all log message of this logger is format.
+	 */
+	~DeferredTextLogger();
+
+	/**
+	 * Gets logger name.
+	 */
+	const std::string& get_name() const;
+
+	/**
+	 * Gets log sink.
+	 */
+	sinks::AsyncSink& get_sink();
+
+	/**
+	 * Gets logger level.
+	 */
+	LogLevel get_level() const;
+
+	/**
+	 * Sets logger level and all log message level is greater or equal to this
+	 * level will be record to sink.
+	 */
+	void set_level(LogLevel level);
+
+	/**
+	 * Checks is open switch of record source location. The default value is open.
+	 */
+	bool is_record_location() const;
+
+	/**
+	 * Sets switch of record source location.
+	 * @note Open switch can get more info, but also will raise output.
+	 */
+	void set_record_location(bool enable_record);
+
+	/**
+	 * Stores @ args and log to sink, @c fmt will be format with @c args in backend thread.
+	 * @param level     Level of log message.
+	 * @param location  Where call this function.
+	 * @param fmt       Format string of log message.
+	 * @param args      Arguments of format.
+	 */
+	template <typename ... Args>
+	void log(LogLevel level, const SourceLocation& location, const char* fmt, const Args& ... args);
+
+	/**
+	 * Logs str to sink.
+	 * @param level     Level of log message.
+	 * @param location  Where call this function.
+	 * @param str       Log message.
+	 */
+	void log(LogLevel level, const SourceLocation& location, const char* str);
+
+	/**
+	 * Logs value to sink.
+	 * @param level     Level of log message.
+	 * @param location  Where call this function.
+	 * @param value     Any type that can be format.
+	 */
+	template <typename T>
+	void log(LogLevel level, const SourceLocation& location, const T& value);
+
+private:
+	bool should_log(LogLevel level) const;
+
+	Sequence write_target() const;
+
+	void generate_signature(LogLevel level, const SourceLocation& location, StringView description);
+
+	void sink_msg(std::size_t argument_length);
+
+	static void render(SequenceView record, Sink& backend);
+
+	std::string m_name;
+	LogLevel m_level;
+	bool m_record_location;
+	sinks::AsyncSink& m_sink;
 };
 
 
 /**
  * BinaryMessageSignature is binary log message common header.
+ * @details Layout of log message is signature, arguments and tail that records argument length.
+ *          When argument length is not less than BINARY_LARGE_ARGUMENT_LENGTH, argument_length
+ *          is set to BINARY_LARGE_ARGUMENT_LENGTH and the real length is records as std::uint32_t
+ *          in front of arguments and in front of tail.
  */
 struct BinaryMessageSignature
 {
@@ -159,96 +431,513 @@ public:
 } LIGHTS_NOT_MEMORY_ALIGNMENT;
 
 
+/**
+ * BinaryLogFileHeader is place at the beginning of binary log file that write by
+ * BinaryLogFileFormat. The file that has no header is the original format, every
+ * log message in it starts with BinaryMessageSignature.
+ * @details Since version 2 (varint), header is follow by BinaryLogTimeBase that is the base time of file.
+ *          Since version 3 (block), BinaryLogTimeBase is follow by std::uint32_t that is block size.
+ *          Since version 4 (checksum), every record has a CRC32C checksum, so reader can skip corrupt
+ *          region and resynchronize at the next block header. And block size may be follow
+ *          by std::uint32_t that is flags of file.
+ */
+struct BinaryLogFileHeader
+{
+	char magic[8];
+	std::uint16_t version;
+	std::uint16_t header_length; // Length of whole header, use to skip the unknown part of header.
+} LIGHTS_NOT_MEMORY_ALIGNMENT;
+
+
+/**
+ * BinaryLogTimeBase is the absolute time that time delta of the following log message base on.
+ */
+struct BinaryLogTimeBase
+{
+	std::int64_t time_seconds;
+	std::int64_t time_nanoseconds;
+} LIGHTS_NOT_MEMORY_ALIGNMENT;
+
+
+/**
+ * BinaryLogBlockHeader is payload of control record that starts a block in file of version 3 or later.
+ * File is split into blocks of the same size after file header. Block header is always place
+ * at the beginning of block, so reader can locate block by offset and binary search line
+ * by record ordinal. But block may have no header when it's cover by a log message that is
+ * larger than block.
+ * @details Time of block header is the time base of the following log message.
+ */
+struct BinaryLogBlockHeader
+{
+	std::uint64_t block_index;
+	std::uint64_t first_record_ordinal; // Number of log message in front of this block.
+	std::int64_t time_seconds;
+	std::int64_t time_nanoseconds;
+} LIGHTS_NOT_MEMORY_ALIGNMENT;
+
+
+/**
+ * BinaryLogBlockEnd is payload of control record that fills the remaining space of block.
+ * Padding is place after it to make record end at the block boundary.
+ * @note The last block of file has no block end, because it's still writing.
+ */
+struct BinaryLogBlockEnd
+{
+	std::uint32_t record_count;
+	std::int64_t last_time_seconds;
+	std::int64_t last_time_nanoseconds;
+} LIGHTS_NOT_MEMORY_ALIGNMENT;
+
+
+/**
+ * BinaryCallSiteSignature is binary log message header in file of version 1.
+ * The information that never change at the same call site is replace by call site id.
+ * @details Since version 2, log message is encode with varint and layout is:
+ *          varint(call_site_id + 1), zigzag varint(nanoseconds since previous log message),
+ *          varint(argument_length), arguments, reverse varint(length of log message without tail).
+ *          Control record has a zero in place of call site, and layout is:
+ *          0, control type, varint(payload length), payload, reverse varint(length of record without tail).
+ *          Since version 4, std::uint32_t CRC32C of record from begin to payload end is place in
+ *          front of reverse varint, and reverse varint is count it in.
+ */
+struct BinaryCallSiteSignature
+{
+	std::int64_t time_seconds;
+	std::int64_t time_nanoseconds;
+	std::uint32_t call_site_id;
+	std::uint16_t argument_length;
+} LIGHTS_NOT_MEMORY_ALIGNMENT;
+
+
+namespace details {
+
+constexpr char BINARY_LOG_MAGIC[] = "LIGHTBIN";
+
+constexpr std::uint16_t BINARY_LOG_VERSION_ORIGINAL = 0;
+constexpr std::uint16_t BINARY_LOG_VERSION_CALL_SITE = 1;
+constexpr std::uint16_t BINARY_LOG_VERSION_VARINT = 2;
+constexpr std::uint16_t BINARY_LOG_VERSION_BLOCK = 3;
+constexpr std::uint16_t BINARY_LOG_VERSION_CHECKSUM = 4;
+
+/**
+ * Argument length that marks log message as large record.
+ */
+constexpr std::uint16_t BINARY_LARGE_ARGUMENT_LENGTH = 0xFFFF;
+
+/**
+ * Type of control record in binary log file.
+ */
+constexpr std::uint8_t BINARY_LOG_CONTROL_TIME_BASE = 1;
+constexpr std::uint8_t BINARY_LOG_CONTROL_BLOCK = 2;
+constexpr std::uint8_t BINARY_LOG_CONTROL_BLOCK_END = 3;
+constexpr std::uint8_t BINARY_LOG_CONTROL_PADDING = 4;
+constexpr std::uint8_t BINARY_LOG_CONTROL_STRING = 5; // Payload is varint(index) and string of string table.
+
+/**
+ * Flags of binary log file.
+ */
+constexpr std::uint32_t BINARY_LOG_FLAG_INLINE_STR_TABLE = 1;
+
+/**
+ * Size of block in binary log file.
+ */
+constexpr std::size_t BINARY_LOG_BLOCK_SIZE = 64 * 1024;
+
+/**
+ * BinaryCallSite is the static information of log message.
+ */
+struct BinaryCallSite
+{
+	std::uint32_t file_id;
+	std::uint32_t function_id;
+	std::uint32_t source_line;
+	std::uint32_t description_id;
+	std::uint32_t logger_id;
+	LogLevel level;
+};
+
+struct BinaryCallSiteHash
+{
+	std::size_t operator()(const BinaryCallSite& call_site) const noexcept
+	{
+		std::size_t hash = call_site.description_id;
+		hash = hash * 31 + call_site.file_id;
+		hash = hash * 31 + call_site.source_line;
+		hash = hash * 31 + call_site.logger_id;
+		return hash;
+	}
+};
+
+struct BinaryCallSiteEqualTo
+{
+	bool operator()(const BinaryCallSite& lhs, const BinaryCallSite& rhs) const noexcept
+	{
+		return lhs.file_id == rhs.file_id &&
+			   lhs.function_id == rhs.function_id &&
+			   lhs.source_line == rhs.source_line &&
+			   lhs.description_id == rhs.description_id &&
+			   lhs.logger_id == rhs.logger_id &&
+			   lhs.level == rhs.level;
+	}
+};
+
+} // namespace details
+
+
 /**
  * BinaryLogger logs message with binary mode to the backend sink. Binary log message is
  * optimized with output, so can save output and record more information. On the other hand,
  * binary log message is structured and can be convenient analyse.
  * Binary log message can use BinaryLogReader to read it.
+ * @details Logger can be share with multiple thread as TextLogger. But backend sink must
+ *          support to write in multiple thread.
+ */
+class BinaryLogger
+{
+public:
+	/**
+	 * Creates binary logger.
+	 * @note Caller must ensure lifecycle of `sink` and `str_table`.
+	 */
+	BinaryLogger(const std::string& name, Sink& sink, StringTable& str_table);
+
+	/**
+	 * Gets logger name.
+	 */
+	const std::string& get_name() const;
+
+	/**
+	 * Gets log sink.
+	 */
+	Sink& get_sink();
+
+	/**
+	 * Sets log sink.
+	 * @note Caller must ensure lifecycle of `sink`.
+	 */
+	void set_sink(Sink& sink);
+
+	/**
+	 * Gets logger level.
+	 */
+	LogLevel get_level() const;
+
+	/**
+	 * Sets logger level.
+	 */
+	void set_level(LogLevel level);
+
+	/**
+	 * Gets how to store integer argument.
+	 */
+	BinaryIntegerEncoding get_integer_encoding() const;
+
+	/**
+	 * Sets how to store integer argument. Varint encoding uses less space for small integer.
+	 * @note Reader must be able to decode varint.
+	 */
+	void set_integer_encoding(BinaryIntegerEncoding integer_encoding);
+
+	/**
+	 * Formats @c fmt with @ args and log to sink.
+	 * @param level     Level of log message.
+	 * @param location  Where call this function.
+	 * @param fmt       Format string of log message.
+	 * @param args      Arguments of format.
+	 */
+	template <typename ... Args>
+	void log(LogLevel level, const SourceLocation& location, const char* fmt, const Args& ... args);
+
+	/**
+	 * Logs str to sink.
+	 * @param level     Level of log message.
+	 * @param location  Where call this function.
+	 * @param str       Log message.
+	 */
+	void log(LogLevel level, const SourceLocation& location, const char* str);
+
+	/**
+	 * Logs value to sink.
+	 * @param level     Level of log message.
+	 * @param location  Where call this function.
+	 * @param value     Any type that can be format.
+	 */
+	template <typename T>
+	void log(LogLevel level, const SourceLocation& location, const T& value);
+
+	/**
+	 * Formats @c fmt with @ args and log to sink. String table index of call site will be cache.
+	 * @param level      Level of log message.
+	 * @param call_site  Where call this function.
+	 * @param fmt        Format string of log message.
+	 * @param args       Arguments of format.
+	 */
+	template <typename ... Args>
+	void log(LogLevel level, LogCallSite& call_site, const char* fmt, const Args& ... args);
+
+	/**
+	 * Logs str to sink. String table index of call site will be cache.
+	 * @param level      Level of log message.
+	 * @param call_site  Where call this function.
+	 * @param str        Log message.
+	 */
+	void log(LogLevel level, LogCallSite& call_site, const char* str);
+
+	/**
+	 * Logs value to sink. String table index of call site will be cache.
+	 * @param level      Level of log message.
+	 * @param call_site  Where call this function.
+	 * @param value      Any type that can be format.
+	 */
+	template <typename T>
+	void log(LogLevel level, LogCallSite& call_site, const T& value);
+
+private:
+	bool should_log(LogLevel level) const;
+
+	Sequence write_target(Sequence buffer) const;
+
+	void generate_signature(BinaryMessageSignature& signature,
+							LogLevel level,
+							const SourceLocation& location,
+							StringView description);
+
+	void generate_signature(BinaryMessageSignature& signature,
+							LogLevel level,
+							LogCallSite& call_site,
+							const char* description);
+
+	/**
+	 * Stores arguments by @c write_arguments and sinks log message. When log message is too
+	 * large for format buffer, formats again with spill buffer that can hold the length
+	 * required by first format.
+	 */
+	template <typename Function>
+	void sink_msg(const BinaryMessageSignature& signature, Function write_arguments);
+
+	void sink_msg(const BinaryMessageSignature& signature, Sequence buffer, const BinaryStoreWriter& writer);
+
+	std::string m_name;
+	LogLevel m_level;
+	Sink& m_sink;
+	StringTable& m_str_table;
+	std::uint32_t m_logger_id;
+	BinaryIntegerEncoding m_integer_encoding;
+};
+
+
+
+/**
+ * BinaryLogFileFormat is a compact file format for log message of BinaryLogger. Use it
+ * with file sink, all log message that write by BinaryLogger will be encode by it.
+ * Every call site is put into string table as a dictionary entry at the first time it
+ * appears. So log message only records call site id, time and arguments.
+ * Time is record as the delta of previous log message in file and all number is encode
+ * as varint.
+ * @details When inline string table is enable, string is write into file before the first
+ *          record that use it in this file, so file can be read without string table file,
+ *          even if process crashes. Strings that are not used by file are not written.
+ * @note Use the same string table with BinaryLogger.
+ */
+class BinaryLogFileFormat : public sinks::LogFileFormat
+{
+public:
+	/**
+	 * Creates format.
+	 */
+	explicit BinaryLogFileFormat(StringTable& str_table);
+
+	/**
+	 * Writes file header when file is empty, otherwise checks format of file.
+	 * New strings of string table are written into its file first when flush policy asks.
+	 * @return Returns false when file is not write by the same format and version.
+	 */
+	bool begin_file(FileStream& file) override;
+
+	/**
+	 * Encodes log message of BinaryLogger and writes into @c file.
+	 * New strings of string table are written into its file by flush policy.
+	 * @throw Thrown InvalidArgument when log message is not write by BinaryLogger.
+	 */
+	std::size_t write(FileStream& file, SequenceView log_msg) override;
+
+	/**
+	 * Returns the max length that writes log message into the current file, include strings
+	 * that have not been written and block end when log message cannot put into the current block.
+	 * @throw Thrown InvalidArgument when log message is not write by BinaryLogger.
+	 */
+	std::size_t max_write_length(SequenceView log_msg) override;
+
+	/**
+	 * Writes strings of string table into file as record. It's take effect at the next file.
+	 */
+	void set_inline_str_table(bool enable);
+
+private:
+	/**
+	 * Gets signature and arguments of log message.
+	 * @throw Thrown InvalidArgument when log message is not write by BinaryLogger.
+	 */
+	void parse_msg(SequenceView log_msg,
+				   BinaryMessageSignature& signature,
+				   const std::uint8_t*& arguments,
+				   std::size_t& argument_length);
+
+	std::uint32_t get_call_site_id(const BinaryMessageSignature& signature);
+
+	/**
+	 * Gets strings that are used by log message and have not been written into the current file.
+	 */
+	void get_inline_str(const BinaryMessageSignature& signature, std::uint32_t call_site_id, SequenceView arguments);
+
+	/**
+	 * Writes strings that are got by @c get_inline_str.
+	 */
+	std::size_t write_inline_str(FileStream& file, std::int64_t time);
+
+	/**
+	 * Reads the last block of file to continue record ordinal and time.
+	 * @return Returns true when all records of the last block are complete.
+	 */
+	bool recover_block(FileStream& file);
+
+	/**
+	 * Returns length of control record that payload length is @c payload_length.
+	 */
+	static std::size_t control_length(std::size_t payload_length);
+
+	std::size_t write_control(FileStream& file, std::uint8_t type, SequenceView payload);
+
+	/**
+	 * Writes control record that length is @c record_length. Payload is fill by zero after @c payload.
+	 * @return Returns zero when cannot make a record of this length.
+	 */
+	std::size_t write_padding_control(FileStream& file,
+									  std::uint8_t type,
+									  SequenceView payload,
+									  std::size_t record_length);
+
+	std::size_t begin_block(FileStream& file, std::int64_t time);
+
+	/**
+	 * Fills the remaining space of block.
+	 */
+	std::size_t end_block(FileStream& file);
+
+	std::size_t remain_block_space() const;
+
+	/**
+	 * Checks block has no record except block header.
+	 */
+	bool is_block_empty() const;
+
+	StringTable& m_str_table;
+	std::int64_t m_last_time; // Nanoseconds since epoch.
+	std::size_t m_data_begin;
+	std::size_t m_block_size;
+	std::size_t m_file_offset;
+	std::size_t m_block_data_begin; // File offset after block header.
+	std::uint64_t m_record_ordinal; // Ordinal of the next log message.
+	std::uint32_t m_block_record_count;
+	bool m_inline_str_table;
+	bool m_file_inline_str_table; // Inline string table is enable in the current file.
+	std::vector<bool> m_inline_str_written; // Index is string index that is written into the current file.
+	std::vector<std::uint32_t> m_inline_str_indexes; // Strings that are used by log message and not written.
+	std::vector<std::uint32_t> m_str_ref_indexes;
+	std::string m_inline_str_payload;
+	std::unordered_map<details::BinaryCallSite,
+					   std::uint32_t,
+					   details::BinaryCallSiteHash,
+					   details::BinaryCallSiteEqualTo> m_call_site_ids;
+};
+
+
+/**
+ * BinaryLogFilter selects log message by signature, so reader can reject log message before
+ * decoding arguments.
+ * @details String conditions are matched as substring. Each condition is matched with the text
+ *          in string table only once for an id, after that it's only to compare id.
+ * @note Cache of match result is not thread safe, so each reader thread must have its own filter.
  */
-class BinaryLogger
+class BinaryLogFilter
 {
 public:
+	explicit BinaryLogFilter(StringTable& str_table);
+
 	/**
-	 * Creates binary logger.
-	 * @note Caller must ensure lifecycle of `sink` and `str_table`.
+	 * Only selects log message that level is not lower than @c level.
 	 */
-	BinaryLogger(const std::string& name, Sink& sink, StringTable& str_table);
+	void set_level(LogLevel level);
 
 	/**
-	 * Gets logger name.
+	 * Only selects log message that logger name contains @c pattern.
 	 */
-	const std::string& get_name() const;
+	void set_logger(StringView pattern);
 
 	/**
-	 * Gets log sink.
+	 * Only selects log message that source file contains @c pattern.
 	 */
-	Sink& get_sink();
+	void set_file(StringView pattern);
 
 	/**
-	 * Sets log sink.
-	 * @note Caller must ensure lifecycle of `sink`.
+	 * Only selects log message that function contains @c pattern.
 	 */
-	void set_sink(Sink& sink);
+	void set_function(StringView pattern);
 
 	/**
-	 * Gets logger level.
+	 * Only selects log message that description (format string) contains @c pattern.
 	 */
-	LogLevel get_level() const;
+	void set_description(StringView pattern);
 
 	/**
-	 * Sets logger level.
+	 * Only selects log message that time is in [@c begin, @c end].
 	 */
-	void set_level(LogLevel level);
+	void set_time_range(const PreciseTime& begin, const PreciseTime& end);
 
 	/**
-	 * Formats @c fmt with @ args and log to sink.
-	 * @param level     Level of log message.
-	 * @param location  Where call this function.
-	 * @param fmt       Format string of log message.
-	 * @param args      Arguments of format.
+	 * Gets string of id from @c str_table instead, such as reader has its own string table.
+	 * Results of the previous string table are cleared.
 	 */
-	template <typename ... Args>
-	void log(LogLevel level, const SourceLocation& location, const char* fmt, const Args& ... args);
+	void set_str_table(StringTable& str_table);
 
 	/**
-	 * Logs str to sink.
-	 * @param level     Level of log message.
-	 * @param location  Where call this function.
-	 * @param str       Log message.
+	 * Clears result of @c id when string of it is changed.
 	 */
-	void log(LogLevel level, const SourceLocation& location, const char* str);
+	void clear_result(std::uint32_t id);
 
 	/**
-	 * Logs value to sink.
-	 * @param level     Level of log message.
-	 * @param location  Where call this function.
-	 * @param value     Any type that can be format.
+	 * Checks log message is selected.
 	 */
-	template <typename T>
-	void log(LogLevel level, const SourceLocation& location, const T& value);
+	bool match(const BinaryMessageSignature& signature);
 
 private:
-	bool should_log(LogLevel level) const;
-
-	void generate_signature(LogLevel level, const SourceLocation& location, StringView description);
-
-	void set_argument_length(std::uint16_t length);
+	struct StringCondition
+	{
+		std::string pattern;
+		std::unordered_map<std::uint32_t, bool> results; // Key is string id.
+	};
 
-	void sink_msg();
+	bool match(StringCondition& condition, std::uint32_t id);
 
-	std::string m_name;
+	StringTable* m_str_table;
 	LogLevel m_level;
-	Sink& m_sink;
-	StringTable& m_str_table;
-	char m_write_target[WRITER_BUFFER_SIZE_LARGE];
-	BinaryMessageSignature* m_signature;
-	BinaryStoreWriter m_writer;
+	StringCondition m_logger;
+	StringCondition m_file;
+	StringCondition m_function;
+	StringCondition m_description;
+	PreciseTime m_begin_time;
+	PreciseTime m_end_time;
 };
 
 
-
 /**
  * BinaryLogReader can read the log file that write by BinaryLogger.
+ * Both file that write as it is and write by BinaryLogFileFormat can be read.
+ * File that has inline string table is read with its own string table instead of @c str_table,
+ * because file may be appended by process that has different string table. String of the later
+ * record replaces string of the same index.
+ * @note Corrupt record in file of version 4 or later, such as torn write when process crashes, is skip
+ *       with the rest of its block.
  */
 class BinaryLogReader
 {
@@ -260,6 +949,13 @@ public:
 	 */
 	StringView read();
 
+	/**
+	 * Sets filter to skip log message that is not selected by @c filter in @c read().
+	 * Pass nullptr to read all log message.
+	 * @note Filter is not apply to jump. Filter gets string from string table of reader.
+	 */
+	void set_filter(BinaryLogFilter* filter);
+
 	/**
 	 * Jumps to the specify line.
 	 * @param line  When line is positive will jump to the line start from head.
@@ -272,6 +968,57 @@ public:
 	 */
 	void jump_to_end();
 
+	/**
+	 * Seeks to the first log message that is not early than @c time. Log message is assumed to
+	 * be nearly time-ordered.
+	 * @details Headers of block is use as sparse time index in file of version 3 or later, so only the
+	 *          nearest block is read. File of the other version is scan from head.
+	 */
+	void seek_time(const PreciseTime& time);
+
+	/**
+	 * Returns time of the last log message that read by @c read().
+	 */
+	PreciseTime message_time() const;
+
+	/**
+	 * Returns file offset of the last log message that read by @c read().
+	 */
+	std::streamoff message_offset() const;
+
+	/**
+	 * Jumps to the beginning of block. Block is only available in file of version 3 or later.
+	 * @note If block has no header because of it's cover by a large log message,
+	 *       will jump to the nearest block in front of it that has header.
+	 */
+	void jump_to_block(std::size_t block_index);
+
+	/**
+	 * Returns number of block in file.
+	 */
+	std::size_t block_count();
+
+	/**
+	 * Returns file offset of the beginning of block.
+	 */
+	std::streamoff block_offset(std::size_t block_index) const;
+
+	/**
+	 * Reads all strings of inline string table in file, so other reader of the same file can
+	 * share them by @c share_inline_str_table instead of scanning file for them.
+	 * @return Returns false when file has no inline string table, or string of an index is
+	 *         replaced by a later one because string of log message depends on where it is.
+	 */
+	bool load_inline_str_table();
+
+	/**
+	 * Uses strings of inline string table that are loaded by @c reader and never reads inline
+	 * string table of file again.
+	 * @note Both reader must read the same file. Caller must ensure lifecycle of @c reader,
+	 *       and @c reader cannot read any more when it's shared with other thread.
+	 */
+	void share_inline_str_table(BinaryLogReader& reader);
+
 	/**
 	 * Returns is end of file.
 	 */
@@ -288,21 +1035,232 @@ public:
 	void clear_eof();
 
 private:
+	enum RecordType
+	{
+		NO_RECORD,
+		CONTROL_RECORD,
+		MESSAGE_RECORD,
+		CORRUPT_RECORD, // Corrupt region is skip and position is at the next block header.
+	};
+
+	bool detect_format();
+
+	bool read_signature();
+
+	RecordType read_varint_record();
+
+	/**
+	 * Checks record at the current position is complete and checksum is correct.
+	 */
+	bool verify_record();
+
+	/**
+	 * Moves to the nearest block header after the current record.
+	 * @return Returns false and keeps position when cannot find any block header.
+	 */
+	bool resync();
+
+	/**
+	 * Reads string of inline string table and puts it into string table.
+	 */
+	void read_inline_str(std::size_t payload_length);
+
+	/**
+	 * Reads strings of inline string table that in front of @c end and have not been read,
+	 * because reader may jump over them.
+	 */
+	void load_inline_str(std::streamoff end);
+
+	/**
+	 * Uses an empty string table to read inline string table from the beginning, because
+	 * string that is replaced is required again after jump back.
+	 */
+	void reset_inline_str_table();
+
+	void set_str_table(StringTable& str_table);
+
+	std::size_t signature_length() const;
+
+	std::size_t tail_length();
+
+	bool read_large_argument_length();
+
+	/**
+	 * Skips arguments and tail of log message after read signature.
+	 */
+	void skip_content();
+
+	void write_msg(BinaryRestoreWriter& writer);
+
+	const details::BinaryCallSite& get_call_site(std::uint32_t call_site_id);
+
+	const BinaryFormatTemplate& get_format_template(std::uint32_t description_id);
+
+	std::streamoff previous_record(std::streamoff pos);
+
+	void restore_time(std::streamoff pos);
+
 	void jump_from_head(std::size_t line);
 
 	void jump_from_tail(std::size_t line);
 
-	FileStream m_file;
-	StringTable& m_str_table;
+	/**
+	 * Finds the nearest block that has header from @c block_index to front.
+	 * @return Returns false when cannot find any block.
+	 */
+	bool find_block(std::size_t& block_index, BinaryLogBlockHeader& header);
+
+	MappedFileStream m_file;
+	StringTable* m_str_table;
+	std::unique_ptr<StringTable> m_own_str_table; // Use when file has inline string table.
+	bool m_format_detected;
+	std::uint16_t m_version;
+	std::streamoff m_data_begin;
+	std::size_t m_block_size;
+	std::streamoff m_record_begin;
+	std::streamoff m_record_end; // Set by verify_record.
+	bool m_inline_str_table;
+	std::streamoff m_inline_str_offset; // Strings of inline string table in front of it have been read.
+	bool m_inline_str_replaced; // String of string table is replaced since it's empty.
+	std::int64_t m_base_time; // Nanoseconds since epoch.
+	std::int64_t m_last_time;
+	std::unordered_map<std::uint32_t, details::BinaryCallSite> m_call_sites;
+	std::unordered_map<std::uint32_t, BinaryFormatTemplate> m_format_templates; // Key is description id.
 	BinaryMessageSignature m_signature;
+	std::size_t m_argument_length; // Real argument length of large record.
+	SequenceView m_arguments; // Points into mapping of file.
 	char m_write_target[WRITER_BUFFER_SIZE_LARGE];
 	BinaryRestoreWriter m_writer;
+	std::vector<char> m_large_write_target; // Use when log message is too large for m_write_target.
+	BinaryLogFilter* m_filter;
+};
+
+
+/**
+ * RotatingBinaryLogReader reads files that write by SizeRotatingFileSink or TimeRotatingFileSink
+ * as one logical stream.
+ * @details Files are found by name format that use "{}" as placeholder, and ordered by the value
+ *          of placeholder. Value is compared as number when both are number, otherwise as string.
+ *          When the current file has no log message to read and successor is exist, reads the rest
+ *          of current file and then switches to successor. The current file is identified by inode,
+ *          so it still can be found after it's renamed by rotating.
+ */
+class RotatingBinaryLogReader : public NonCopyable
+{
+public:
+	/**
+	 * Creates reader. File is not open until reading.
+	 * @param name_format  Name format of rotating file sink.
+	 */
+	RotatingBinaryLogReader(StringView name_format, StringTable& str_table);
+
+	/**
+	 * Reads log message and switches to the next file when the current file is finished.
+	 * @note Returns nullptr when have no log message to read.
+	 */
+	StringView read();
+
+	/**
+	 * Jumps to end of the last file.
+	 */
+	void jump_to_end();
+
+	/**
+	 * Sets filter of all files.
+	 */
+	void set_filter(BinaryLogFilter* filter);
+
+	/**
+	 * Returns name of the current file. Returns empty string when no file is open.
+	 */
+	const std::string& filename() const;
+
+	/**
+	 * Returns names of all files that match name format in order of rotating.
+	 */
+	std::vector<std::string> list_files() const;
+
+private:
+	void open(const std::string& filename);
+
+	/**
+	 * Finds the file after the current file.
+	 * @return Returns empty string when there is not successor.
+	 */
+	std::string find_successor() const;
+
+	std::string m_name_format;
+	StringTable& m_str_table;
+	BinaryLogFilter* m_filter;
+	std::unique_ptr<BinaryLogReader> m_reader;
+	std::string m_filename;
+	std::uint64_t m_device;
+	std::uint64_t m_inode;
+};
+
+
+/**
+ * BinaryLogMerger merges log messages of multiple readers into a timeline that ordered by time.
+ * Each reader can use its own string table.
+ * @details Only one log message of each reader is pending in heap, so memory use is not depend on
+ *          file size. Log message of each reader is assumed to be time-ordered. When time is same,
+ *          log message of reader that add earlier is read first.
+ * @note Readers must be valid until merger is destroyed.
+ */
+class BinaryLogMerger : public NonCopyable
+{
+public:
+	BinaryLogMerger();
+
+	/**
+	 * Adds reader as input. Cannot add reader after reading.
+	 */
+	void add_reader(BinaryLogReader& reader);
+
+	/**
+	 * Reads the earliest log message of all readers.
+	 * @note Returns nullptr when have no log message to read. Returned log message is valid until
+	 *       next read.
+	 */
+	StringView read();
+
+	/**
+	 * Returns index of reader that the last log message is read from.
+	 */
+	std::size_t reader_index() const;
+
+private:
+	struct PendingMessage
+	{
+		PreciseTime time;
+		std::size_t reader_index;
+		StringView log;
+	};
+
+	struct LaterMessage
+	{
+		bool operator()(const PendingMessage& left, const PendingMessage& right) const;
+	};
+
+	/**
+	 * Reads next log message of reader and puts it into heap.
+	 */
+	void fill_reader(std::size_t reader_index);
+
+	std::vector<BinaryLogReader*> m_readers;
+	std::priority_queue<PendingMessage, std::vector<PendingMessage>, LaterMessage> m_heap;
+	bool m_started;
+	std::size_t m_reader_index; // Reader of the last log message and have to fill next time.
 };
 
 
 #ifdef LIGHTS_OPEN_LOG
 #	define LIGHTS_LOG(logger, level, ...) \
-		logger.log(level, LIGHTS_CURRENT_SOURCE_LOCATION, __VA_ARGS__)
+		do \
+		{ \
+			static lights::LogCallSite lights_log_call_site(LIGHTS_CURRENT_SOURCE_LOCATION); \
+			logger.log(level, lights_log_call_site, __VA_ARGS__); \
+		} while (false)
 #else
 #	define LIGHTS_LOG(logger, level, ...)
 #endif
@@ -324,6 +1282,27 @@ private:
 
 // ========================= Implement. =============================
 
+inline LogCallSite::LogCallSite(const SourceLocation& location) :
+	SourceLocation(location),
+	m_state(EMPTY),
+	m_str_table_id(0),
+	m_description(invalid_string_view()),
+	m_index()
+{}
+
+inline const LogCallSiteIndex* LogCallSite::get_index(const StringTable& str_table, const char* description) const
+{
+	if (m_state.load(std::memory_order_acquire) == READY &&
+		m_str_table_id == str_table.id() &&
+		std::strncmp(description, m_description.data(), m_description.length()) == 0 &&
+		description[m_description.length()] == '\0')
+	{
+		return &m_index;
+	}
+	return nullptr;
+}
+
+
 inline const std::string& TextLogger::get_name() const
 {
 	return m_name;
@@ -364,12 +1343,13 @@ void TextLogger::log(LogLevel level, const SourceLocation& location, const char*
 {
 	if (this->should_log(level))
 	{
-		m_writer.clear();
-		this->generate_signature(level);
-		m_writer.write(fmt, args ...);
-		this->record_location(location);
-		append_log_separator();
-		m_sink.write(m_writer.string_view());
+		details::LogBufferScope scope;
+		TextWriter writer(this->write_target());
+		this->generate_signature(writer, level);
+		writer.write(fmt, args ...);
+		this->record_location(writer, location);
+		this->append_log_separator(writer);
+		m_sink.write(writer.string_view());
 	}
 }
 
@@ -378,12 +1358,13 @@ void TextLogger::log(LogLevel level, const SourceLocation& location, const T& va
 {
 	if (this->should_log(level))
 	{
-		m_writer.clear();
-		this->generate_signature(level);
-		m_writer << value;
-		this->record_location(location);
-		append_log_separator();
-		m_sink.write(m_writer.string_view());
+		details::LogBufferScope scope;
+		TextWriter writer(this->write_target());
+		this->generate_signature(writer, level);
+		writer << value;
+		this->record_location(writer, location);
+		this->append_log_separator(writer);
+		m_sink.write(writer.string_view());
 	}
 }
 
@@ -392,6 +1373,83 @@ inline bool TextLogger::should_log(LogLevel level) const
 	return m_level <= level;
 }
 
+inline String TextLogger::write_target() const
+{
+	return String(details::thread_log_buffer(), WRITER_BUFFER_SIZE_DEFAULT);
+}
+
+
+inline const std::string& DeferredTextLogger::get_name() const
+{
+	return m_name;
+}
+
+inline sinks::AsyncSink& DeferredTextLogger::get_sink()
+{
+	return m_sink;
+}
+
+inline LogLevel DeferredTextLogger::get_level() const
+{
+	return m_level;
+}
+
+inline void DeferredTextLogger::set_level(LogLevel level)
+{
+	m_level = level;
+}
+
+inline bool DeferredTextLogger::is_record_location() const
+{
+	return m_record_location;
+}
+
+inline void DeferredTextLogger::set_record_location(bool enable_record)
+{
+	m_record_location = enable_record;
+}
+
+template <typename ... Args>
+void DeferredTextLogger::log(LogLevel level, const SourceLocation& location, const char* fmt, const Args& ... args)
+{
+	if (this->should_log(level))
+	{
+		details::LogBufferScope scope;
+		this->generate_signature(level, location, fmt);
+		BinaryStoreWriter writer(this->write_target());
+		writer.write(fmt, args ...);
+		this->sink_msg(writer.length());
+	}
+}
+
+template <typename T>
+void DeferredTextLogger::log(LogLevel level, const SourceLocation& location, const T& value)
+{
+	if (this->should_log(level))
+	{
+		details::LogBufferScope scope;
+		const char* description = "{}";
+		this->generate_signature(level, location, description);
+		BinaryStoreWriter writer(this->write_target());
+		writer.write(description, value);
+		this->sink_msg(writer.length());
+	}
+}
+
+inline bool DeferredTextLogger::should_log(LogLevel level) const
+{
+	return m_level <= level;
+}
+
+inline Sequence DeferredTextLogger::write_target() const
+{
+	// Arguments is place after signature and description that generate before.
+	char* buffer = details::thread_log_buffer();
+	std::size_t offset = sizeof(DeferredTextSignature) +
+		reinterpret_cast<DeferredTextSignature*>(buffer)->description_length;
+	return Sequence(buffer + offset, details::LOG_BUFFER_SIZE - offset);
+}
+
 
 inline const std::string& BinaryLogger::get_name() const
 {
@@ -418,17 +1476,26 @@ inline void BinaryLogger::set_level(LogLevel level)
 	m_level = level;
 }
 
+inline BinaryIntegerEncoding BinaryLogger::get_integer_encoding() const
+{
+	return m_integer_encoding;
+}
+
+inline void BinaryLogger::set_integer_encoding(BinaryIntegerEncoding integer_encoding)
+{
+	m_integer_encoding = integer_encoding;
+}
+
 template <typename ... Args>
 void BinaryLogger::log(LogLevel level, const SourceLocation& location, const char* fmt, const Args& ... args)
 {
 	if (this->should_log(level))
 	{
-		this->generate_signature(level, location, fmt);
-
-		m_writer.clear();
-		m_writer.write(fmt, args ...);
-		this->set_argument_length(static_cast<std::uint16_t>(m_writer.length()));
-		this->sink_msg();
+		BinaryMessageSignature signature;
+		this->generate_signature(signature, level, location, fmt);
+		this->sink_msg(signature, [&](BinaryStoreWriter& writer) {
+			writer.write(fmt, args ...);
+		});
 	}
 }
 
@@ -437,13 +1504,39 @@ void BinaryLogger::log(LogLevel level, const SourceLocation& location, const T&
 {
 	if (this->should_log(level))
 	{
+		BinaryMessageSignature signature;
 		const StringView description = "{}";
-		this->generate_signature(level, location, description);
+		this->generate_signature(signature, level, location, description);
+		this->sink_msg(signature, [&](BinaryStoreWriter& writer) {
+			writer.write(description, value);
+		});
+	}
+}
+
+template <typename ... Args>
+void BinaryLogger::log(LogLevel level, LogCallSite& call_site, const char* fmt, const Args& ... args)
+{
+	if (this->should_log(level))
+	{
+		BinaryMessageSignature signature;
+		this->generate_signature(signature, level, call_site, fmt);
+		this->sink_msg(signature, [&](BinaryStoreWriter& writer) {
+			writer.write(fmt, args ...);
+		});
+	}
+}
 
-		m_writer.clear();
-		m_writer.write(description, value);
-		this->set_argument_length(static_cast<std::uint16_t>(m_writer.length()));
-		this->sink_msg();
+template <typename T>
+void BinaryLogger::log(LogLevel level, LogCallSite& call_site, const T& value)
+{
+	if (this->should_log(level))
+	{
+		BinaryMessageSignature signature;
+		const char* description = "{}";
+		this->generate_signature(signature, level, call_site, description);
+		this->sink_msg(signature, [&](BinaryStoreWriter& writer) {
+			writer.write(description, value);
+		});
 	}
 }
 
@@ -452,24 +1545,53 @@ inline bool BinaryLogger::should_log(LogLevel level) const
 	return m_level <= level;
 }
 
-inline void BinaryLogger::set_argument_length(std::uint16_t length)
+inline Sequence BinaryLogger::write_target(Sequence buffer) const
 {
-	m_signature->argument_length = length;
-	char* tail_length = m_write_target + sizeof(BinaryMessageSignature) + m_writer.length();
-	*reinterpret_cast<std::uint16_t*>(tail_length) = m_signature->argument_length;
+	// Signature is place in front of arguments and the end is reverse for length of large record and tail length.
+	return Sequence(static_cast<char*>(buffer.data()) + sizeof(BinaryMessageSignature),
+					buffer.length() - sizeof(BinaryMessageSignature) -
+						sizeof(std::uint32_t) * 2 - sizeof(std::uint16_t));
 }
 
-inline void BinaryLogger::sink_msg()
+template <typename Function>
+void BinaryLogger::sink_msg(const BinaryMessageSignature& signature, Function write_arguments)
 {
-	// signature + content + tail length.
-	SequenceView view(m_write_target, sizeof(BinaryMessageSignature) + m_writer.size() + sizeof(std::uint16_t));
-	m_sink.write(view);
+	details::LogBufferScope scope;
+	Sequence buffer(details::thread_log_buffer(), details::LOG_BUFFER_SIZE);
+	while (true)
+	{
+		BinaryStoreWriter writer(this->write_target(buffer), &m_str_table, m_integer_encoding);
+		write_arguments(writer);
+		if (!writer.is_overflow() || buffer.length() >= details::LOG_SPILL_BUFFER_MAX_SIZE)
+		{
+			this->sink_msg(signature, buffer, writer);
+			return;
+		}
+
+		// Grows at least twice in case required length is not exact.
+		std::size_t required = writer.required_length() + buffer.length() - writer.max_size();
+		required = std::max(required, buffer.length() * 2);
+		buffer = details::thread_spill_buffer(std::min(required, details::LOG_SPILL_BUFFER_MAX_SIZE));
+	}
 }
 
 
-inline void BinaryLogReader::jump_to_end()
+inline std::size_t BinaryLogReader::signature_length() const
+{
+	if (m_version == details::BINARY_LOG_VERSION_CALL_SITE)
+	{
+		return sizeof(BinaryCallSiteSignature);
+	}
+	return sizeof(BinaryMessageSignature);
+}
+
+inline void BinaryLogReader::set_filter(BinaryLogFilter* filter)
 {
-	m_file.seek(0, FileSeekWhence::END);
+	m_filter = filter;
+	if (m_filter != nullptr)
+	{
+		m_filter->set_str_table(*m_str_table);
+	}
 }
 
 inline bool BinaryLogReader::eof()
@@ -0,0 +1,164 @@
+/**
+ * ring_buffer.cpp
+ * @author wherewindblow
+ * @date   Oct 16, 2026
+ */
+
+#include "ring_buffer.h"
+
+#include <cstring>
+
+
+namespace lights {
+
+namespace details {
+
+constexpr std::size_t RING_BUFFER_ALIGNMENT = 8;
+
+inline std::size_t align_record(std::size_t length)
+{
+	return (length + RING_BUFFER_ALIGNMENT - 1) & ~(RING_BUFFER_ALIGNMENT - 1);
+}
+
+inline std::size_t round_up_power_of_two(std::size_t n)
+{
+	std::size_t result = RING_BUFFER_ALIGNMENT * 2;
+	while (result < n)
+	{
+		result <<= 1;
+	}
+	return result;
+}
+
+} // namespace details
+
+
+RingBuffer::RingBuffer(std::size_t capacity) :
+	m_buffer(nullptr),
+	m_capacity(details::round_up_power_of_two(capacity)),
+	m_write_pos(0),
+	m_read_pos(0)
+{
+	m_buffer = new std::uint8_t[m_capacity];
+	std::memset(m_buffer, 0, m_capacity);
+}
+
+
+RingBuffer::~RingBuffer()
+{
+	delete[] m_buffer;
+}
+
+
+bool RingBuffer::push(SequenceView record)
+{
+	std::uint8_t* storage = reserve(record.length());
+	if (storage == nullptr)
+	{
+		return false;
+	}
+
+	std::memcpy(storage + sizeof(RecordHeader), record.data(), record.length());
+	auto header = reinterpret_cast<RecordHeader*>(storage);
+	header->length.store(static_cast<std::uint32_t>(record.length()), std::memory_order_release);
+	return true;
+}
+
+
+bool RingBuffer::push(SequenceView first, SequenceView second)
+{
+	std::uint8_t* storage = reserve(first.length() + second.length());
+	if (storage == nullptr)
+	{
+		return false;
+	}
+
+	std::memcpy(storage + sizeof(RecordHeader), first.data(), first.length());
+	std::memcpy(storage + sizeof(RecordHeader) + first.length(), second.data(), second.length());
+	auto header = reinterpret_cast<RecordHeader*>(storage);
+	auto length = static_cast<std::uint32_t>(first.length() + second.length());
+	header->length.store(length, std::memory_order_release);
+	return true;
+}
+
+
+std::uint8_t* RingBuffer::reserve(std::size_t length)
+{
+	// Zero length is use as not commit flag, so always reserve one byte at least.
+	if (length == 0 || length > max_record_size())
+	{
+		return nullptr;
+	}
+
+	const std::size_t record_size = details::align_record(sizeof(RecordHeader) + length);
+	std::size_t pos = m_write_pos.load(std::memory_order_relaxed);
+	std::size_t padding;
+	while (true)
+	{
+		std::size_t offset = pos & (m_capacity - 1);
+		padding = (offset + record_size > m_capacity) ? m_capacity - offset : 0;
+		std::size_t read_pos = m_read_pos.load(std::memory_order_acquire);
+		if (pos + padding + record_size - read_pos > m_capacity)
+		{
+			return nullptr;
+		}
+
+		if (m_write_pos.compare_exchange_weak(pos, pos + padding + record_size,
+											  std::memory_order_acq_rel,
+											  std::memory_order_relaxed))
+		{
+			break;
+		}
+	}
+
+	if (padding != 0)
+	{
+		// Record cannot cross the end of buffer, so skip the tail of buffer.
+		RecordHeader* padding_header = header_at(pos);
+		padding_header->is_padding = 1;
+		padding_header->length.store(static_cast<std::uint32_t>(padding), std::memory_order_release);
+		pos += padding;
+	}
+
+	RecordHeader* header = header_at(pos);
+	header->is_padding = 0;
+	return reinterpret_cast<std::uint8_t*>(header);
+}
+
+
+SequenceView RingBuffer::front()
+{
+	while (true)
+	{
+		std::size_t pos = m_read_pos.load(std::memory_order_relaxed);
+		RecordHeader* header = header_at(pos);
+		std::uint32_t length = header->length.load(std::memory_order_acquire);
+		if (length == 0)
+		{
+			return invalid_sequence_view();
+		}
+
+		if (header->is_padding)
+		{
+			std::memset(static_cast<void*>(header), 0, length);
+			m_read_pos.store(pos + length, std::memory_order_release);
+			continue;
+		}
+
+		return SequenceView(reinterpret_cast<std::uint8_t*>(header) + sizeof(RecordHeader), length);
+	}
+}
+
+
+void RingBuffer::pop()
+{
+	std::size_t pos = m_read_pos.load(std::memory_order_relaxed);
+	RecordHeader* header = header_at(pos);
+	std::size_t record_size = details::align_record(sizeof(RecordHeader) + header->length.load(std::memory_order_relaxed));
+
+	// Clears all record space, ensure other record header that place at here is not commit.
+	std::memset(static_cast<void*>(header), 0, record_size);
+	m_read_pos.store(pos + record_size, std::memory_order_release);
+}
+
+} // namespace lights
\ No newline at end of file
@@ -0,0 +1,118 @@
+/**
+ * ring_buffer.h
+ * @author wherewindblow
+ * @date   Oct 16, 2026
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+
+#include "sequence.h"
+#include "non_copyable.h"
+
+
+namespace lights {
+
+/**
+ * RingBuffer is a lock-free multiple producer and single consumer queue of variable length record.
+ * Producer reserves space by atomic operation and copies record into it. Consumer reads record
+ * by the order of reservation.
+ * @note Only one thread can call @c front() and @c pop() at the same time.
+ */
+class RingBuffer : public NonCopyable
+{
+public:
+	/**
+	 * Creates ring buffer.
+	 * @param capacity  Bytes of buffer. It'll be round up to power of two.
+	 */
+	explicit RingBuffer(std::size_t capacity);
+
+	/**
+	 * Destroys ring buffer.
+	 */
+	~RingBuffer();
+
+	/**
+	 * Copies record into buffer.
+	 * @return Returns false when have not enough space to hold record.
+	 */
+	bool push(SequenceView record);
+
+	/**
+	 * Copies records into buffer as one record.
+	 * @return Returns false when have not enough space to hold record.
+	 */
+	bool push(SequenceView first, SequenceView second);
+
+	/**
+	 * Gets the first record.
+	 * @note Returns invalid sequence view when have no record or first record is not commit yet.
+	 */
+	SequenceView front();
+
+	/**
+	 * Removes the first record.
+	 * @note Must ensure @c front() is valid before call it.
+	 */
+	void pop();
+
+	/**
+	 * Checks have no record. Include the record that is not commit yet.
+	 */
+	bool empty() const;
+
+	/**
+	 * Returns the buffer size.
+	 */
+	std::size_t capacity() const;
+
+	/**
+	 * Returns the max size of a record that can be push.
+	 */
+	std::size_t max_record_size() const;
+
+private:
+	struct RecordHeader
+	{
+		std::atomic<std::uint32_t> length; // Zero is not commit yet.
+		std::uint32_t is_padding;
+	};
+
+	RecordHeader* header_at(std::size_t pos);
+
+	std::uint8_t* reserve(std::size_t length);
+
+	std::uint8_t* m_buffer;
+	std::size_t m_capacity;
+	alignas(64) std::atomic<std::size_t> m_write_pos;
+	alignas(64) std::atomic<std::size_t> m_read_pos;
+};
+
+
+// ========================= Implement. ==============================
+
+inline bool RingBuffer::empty() const
+{
+	return m_read_pos.load(std::memory_order_acquire) == m_write_pos.load(std::memory_order_acquire);
+}
+
+inline std::size_t RingBuffer::capacity() const
+{
+	return m_capacity;
+}
+
+inline std::size_t RingBuffer::max_record_size() const
+{
+	return m_capacity / 2 - sizeof(RecordHeader);
+}
+
+inline RingBuffer::RecordHeader* RingBuffer::header_at(std::size_t pos)
+{
+	return reinterpret_cast<RecordHeader*>(m_buffer + (pos & (m_capacity - 1)));
+}
+
+} // namespace lights
\ No newline at end of file
@@ -0,0 +1,172 @@
+/**
+ * async_sink.cpp
+ * @author wherewindblow
+ * @date   Oct 16, 2026
+ */
+
+#include "async_sink.h"
+
+#include <chrono>
+#include <cstring>
+
+
+namespace lights {
+namespace sinks {
+
+namespace details {
+
+/**
+ * Times of spin before backend thread go to sleep when have nothing to do.
+ */
+constexpr int ASYNC_SINK_SPIN_TIMES = 100;
+
+/**
+ * Duration that backend thread sleep when have nothing to do.
+ */
+constexpr std::chrono::microseconds ASYNC_SINK_IDLE_SLEEP(100);
+
+} // namespace details
+
+
+AsyncSink::AsyncSink(Sink& backend, std::size_t buffer_size, AsyncOverflowPolicy policy) :
+	m_backend(backend),
+	m_policy(policy),
+	m_buffer(buffer_size),
+	m_stop(false),
+	m_dropped_count(0),
+	m_write_error_count(0),
+	m_thread()
+{
+	m_thread = std::thread(&AsyncSink::run, this);
+}
+
+
+AsyncSink::~AsyncSink()
+{
+	m_stop.store(true, std::memory_order_release);
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+	}
+}
+
+
+std::size_t AsyncSink::write(SequenceView log_msg)
+{
+	return this->write(log_msg, nullptr);
+}
+
+
+std::size_t AsyncSink::write(SequenceView record, Renderer renderer)
+{
+	if (record.length() == 0)
+	{
+		return 0;
+	}
+
+	if (sizeof(renderer) + record.length() > m_buffer.max_record_size())
+	{
+		// Keeps order with log message that is written before by the same thread.
+		this->flush();
+		std::lock_guard<std::mutex> lock(m_backend_mutex);
+		this->write_backend(record, renderer);
+		return record.length();
+	}
+
+	// Renderer is place in front of record.
+	while (!m_buffer.push(SequenceView(&renderer, sizeof(renderer)), record))
+	{
+		if (m_policy == AsyncOverflowPolicy::DROP)
+		{
+			m_dropped_count.fetch_add(1, std::memory_order_relaxed);
+			return 0;
+		}
+		std::this_thread::yield();
+	}
+	return record.length();
+}
+
+
+void AsyncSink::flush()
+{
+	while (!m_buffer.empty())
+	{
+		std::this_thread::yield();
+	}
+}
+
+
+void AsyncSink::run()
+{
+	int idle_times = 0;
+	while (true)
+	{
+		if (write_backend())
+		{
+			idle_times = 0;
+			continue;
+		}
+
+		// Must check buffer again after see stop flag, because producer may write before set stop flag.
+		if (m_stop.load(std::memory_order_acquire) && m_buffer.empty())
+		{
+			break;
+		}
+
+		if (++idle_times < details::ASYNC_SINK_SPIN_TIMES)
+		{
+			std::this_thread::yield();
+		}
+		else
+		{
+			std::this_thread::sleep_for(details::ASYNC_SINK_IDLE_SLEEP);
+		}
+	}
+}
+
+
+bool AsyncSink::write_backend()
+{
+	std::lock_guard<std::mutex> lock(m_backend_mutex);
+	bool have_written = false;
+	while (true)
+	{
+		SequenceView record = m_buffer.front();
+		if (!is_valid(record))
+		{
+			break;
+		}
+
+		Renderer renderer;
+		std::memcpy(&renderer, record.data(), sizeof(renderer));
+		record.move_forward(sizeof(renderer));
+		this->write_backend(record, renderer);
+		m_buffer.pop();
+		have_written = true;
+	}
+	return have_written;
+}
+
+
+void AsyncSink::write_backend(SequenceView record, Renderer renderer)
+{
+	// Exception cannot pass to caller that has returned, and it terminates backend thread.
+	try
+	{
+		if (renderer == nullptr)
+		{
+			m_backend.write(record);
+		}
+		else
+		{
+			renderer(record, m_backend);
+		}
+	}
+	catch (...)
+	{
+		m_write_error_count.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+} // namespace sinks
+} // namespace lights
\ No newline at end of file
@@ -0,0 +1,129 @@
+/**
+ * async_sink.h
+ * @author wherewindblow
+ * @date   Oct 16, 2026
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include "../sequence.h"
+#include "../sink.h"
+#include "../ring_buffer.h"
+
+
+namespace lights {
+namespace sinks {
+
+/**
+ * AsyncOverflowPolicy decides what to do when the buffer of AsyncSink is full.
+ */
+enum class AsyncOverflowPolicy
+{
+	BLOCK, // Waits until backend thread make enough space.
+	DROP,  // Drops log message and count it.
+};
+
+
+/**
+ * AsyncSink copies log message into a lock-free buffer and a backend thread writes them into
+ * the backend sink. So the caller thread will not wait for io and lock of backend sink.
+ * @note Caller must ensure lifecycle of backend sink is longer than this sink.
+ */
+class AsyncSink: public Sink
+{
+public:
+	static constexpr std::size_t DEFAULT_BUFFER_SIZE = 1024 * 1024;
+
+	/**
+	 * Renderer converts record to log message and writes it to backend in backend thread.
+	 */
+	using Renderer = void (*)(SequenceView record, Sink& backend);
+
+	/**
+	 * Creates sink and starts backend thread.
+	 * @param backend      All log message will write to it in backend thread.
+	 * @param buffer_size  Size of buffer to hold log message that is not write to backend.
+	 * @param policy       What to do when buffer is full.
+	 */
+	explicit AsyncSink(Sink& backend,
+					   std::size_t buffer_size = DEFAULT_BUFFER_SIZE,
+					   AsyncOverflowPolicy policy = AsyncOverflowPolicy::BLOCK);
+
+	/**
+	 * Writes all remain log message to backend and stops backend thread.
+	 */
+	~AsyncSink();
+
+	/**
+	 * Copies log message into buffer and return immediately.
+	 * @details Write is lock-free, unless buffer is full and use block policy.
+	 * @note Log message that larger than buffer can hold is write to backend directly in
+	 *       caller thread after all log message in buffer are written.
+	 */
+	std::size_t write(SequenceView log_msg) override;
+
+	/**
+	 * Copies record into buffer and return immediately. Record will be render to log message
+	 * by @c renderer in backend thread.
+	 * @details Write is lock-free, unless buffer is full and use block policy.
+	 *          Record that larger than buffer can hold is render in caller thread directly.
+	 * @note Record cannot reference to any resource that may be invalid before it's render.
+	 */
+	std::size_t write(SequenceView record, Renderer renderer);
+
+	/**
+	 * Waits until all log message that write before are write to backend.
+	 */
+	void flush();
+
+	/**
+	 * Returns number of log message that is drop because of buffer is full.
+	 */
+	std::size_t dropped_count() const;
+
+	/**
+	 * Returns number of log message that is drop because of backend throws exception when
+	 * write it. Backend thread keeps writing the other log message.
+	 */
+	std::size_t write_error_count() const;
+
+private:
+	void run();
+
+	bool write_backend();
+
+	/**
+	 * Writes record to backend and counts it when backend throws exception.
+	 */
+	void write_backend(SequenceView record, Renderer renderer);
+
+	Sink& m_backend;
+	std::mutex m_backend_mutex; // Only contends when caller writes large record directly.
+	AsyncOverflowPolicy m_policy;
+	RingBuffer m_buffer;
+	std::atomic<bool> m_stop;
+	std::atomic<std::size_t> m_dropped_count;
+	std::atomic<std::size_t> m_write_error_count;
+	std::thread m_thread;
+};
+
+
+// ========================= Implement. ==============================
+
+inline std::size_t AsyncSink::dropped_count() const
+{
+	return m_dropped_count.load(std::memory_order_relaxed);
+}
+
+inline std::size_t AsyncSink::write_error_count() const
+{
+	return m_write_error_count.load(std::memory_order_relaxed);
+}
+
+} // namespace sinks
+} // namespace lights
\ No newline at end of file
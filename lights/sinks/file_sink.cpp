@@ -13,11 +13,37 @@
 namespace lights {
 namespace sinks {
 
-SimpleFileSink::SimpleFileSink(StringView filename) :
-	m_file(filename.data(), "ab+"),
-	m_msg_writer(&m_file),
+/**
+ * Opens @c filename to append log message by @c msg_writer. When format cannot append to it,
+ * such as it's written by another version of format, uses the first file of name "filename.N"
+ * that format can append to and keeps the old file unchanged.
+ */
+void open_log_file(FileStream& file, LogMessageWriter& msg_writer, const std::string& filename)
+{
+	std::string name = filename;
+	for (std::size_t i = 1; ; ++i)
+	{
+		if (file.is_open())
+		{
+			file.close();
+		}
+		file.open(name, "ab+");
+		if (msg_writer.set_write_target(&file))
+		{
+			return;
+		}
+		name = format("{}.{}", filename, i);
+	}
+}
+
+
+SimpleFileSink::SimpleFileSink(StringView filename, LogFileFormat* file_format) :
+	m_file(),
+	m_msg_writer(nullptr, file_format),
 	m_mutex()
-{}
+{
+	open_log_file(m_file, m_msg_writer, filename.to_std_string());
+}
 
 
 std::size_t SimpleFileSink::write(SequenceView log_msg)
@@ -36,6 +62,7 @@ SizeRotatingFileSink::SizeRotatingFileSink() :
 	m_msg_writer(),
 	m_index(static_cast<std::size_t>(-1)),
 	m_current_size(0),
+	m_begin_size(0),
 	m_mutex()
 {}
 
@@ -65,6 +92,11 @@ void SizeRotatingFileSink::init_max_files(std::size_t max_files)
 	LIGHTS_SINKS_INIT_MEMBER(m_max_files = max_files);
 }
 
+void SizeRotatingFileSink::init_file_format(LogFileFormat* file_format)
+{
+	LIGHTS_SINKS_INIT_MEMBER(m_msg_writer.set_file_format(file_format));
+}
+
 #undef LIGHTS_SINKS_INIT_MEMBER
 
 
@@ -78,9 +110,13 @@ void SizeRotatingFileSink::end_init()
 std::size_t SizeRotatingFileSink::write(SequenceView log_msg)
 {
 	std::lock_guard<std::mutex> lock(m_mutex);
-	while (m_current_size + log_msg.length() > m_max_size)
+	// Message that cannot put into a new file is written into the current file, otherwise
+	// rotating never ends.
+	std::size_t expect_size = m_msg_writer.max_write_length(log_msg);
+	while (m_current_size > m_begin_size && m_current_size + expect_size > m_max_size)
 	{
-		this->rotate(log_msg.length());
+		this->rotate(expect_size);
+		expect_size = m_msg_writer.max_write_length(log_msg);
 	}
 	std::size_t length = m_msg_writer.write(log_msg);
 	m_current_size += length;
@@ -110,6 +146,8 @@ void SizeRotatingFileSink::fill_remain()
 void SizeRotatingFileSink::rotate(std::size_t expect_size)
 {
 	bool appropriate = false;
+	bool target_set = false;
+	std::size_t open_size = 0;
 	while (m_index + 1 < m_max_files)
 	{
 		++m_index;
@@ -125,22 +163,29 @@ void SizeRotatingFileSink::rotate(std::size_t expect_size)
 		{
 			// Try to use previous file if it have enough space to write a message.
 			auto previous_name = format(m_name_format, m_index - 1);
-			if (!env::file_exists(previous_name.c_str()))
+			if (env::file_exists(previous_name.c_str()))
 			{
 				if (m_file.is_open())
 				{
 					m_file.close();
 				}
 				m_file.open(previous_name, "ab+");
-				if (m_file.size() + expect_size > m_max_size)
+				open_size = m_file.size();
+				// File that is written by another version of format is kept unchanged.
+				if (open_size + expect_size > m_max_size || !m_msg_writer.set_write_target(&m_file))
 				{
 					cannot_use_previous = true;
 				}
 				else
 				{
 					--m_index;
+					target_set = true;
 				}
 			}
+			else // Previous file may be removed, such as by log cleanup.
+			{
+				cannot_use_previous = true;
+			}
 		}
 		else
 		{
@@ -154,6 +199,7 @@ void SizeRotatingFileSink::rotate(std::size_t expect_size)
 				m_file.close();
 			}
 			m_file.open(name, "ab+");
+			open_size = m_file.size();
 		}
 		m_current_size = m_file.size();
 		appropriate = true;
@@ -178,20 +224,38 @@ void SizeRotatingFileSink::rotate(std::size_t expect_size)
 			m_file.close();
 		}
 		m_file.open(last, "ab+");
+		open_size = m_file.size();
+		if (!m_msg_writer.set_write_target(&m_file))
+		{
+			// Last file is left by another format when cannot rename, and it's discarded like the first file.
+			m_file.close();
+			m_file.open(last, "wb+");
+			open_size = 0;
+			m_msg_writer.set_write_target(&m_file);
+		}
+		target_set = true;
 		m_current_size = m_file.size();
 	}
 
-	m_msg_writer.set_write_target(&m_file);
+	if (!target_set)
+	{
+		m_msg_writer.set_write_target(&m_file);
+	}
+	m_current_size = m_file.size(); // Include the file header.
+	if (open_size == 0)
+	{
+		m_begin_size = m_current_size;
+	}
 }
 
 
-TimeRotatingFileSink::TimeRotatingFileSink(std::string name_format, time_t duration, time_t day_point) :
+TimeRotatingFileSink::TimeRotatingFileSink(std::string name_format, time_t duration, time_t day_point, LogFileFormat* file_format) :
 	m_name_format(name_format),
 	m_duration(duration),
 	m_day_point(day_point),
 	m_next_rotating_time(),
 	m_file(),
-	m_msg_writer(),
+	m_msg_writer(nullptr, file_format),
 	m_mutex()
 {
 	if (day_point > ONE_DAY_SECONDS)
@@ -234,14 +298,8 @@ void TimeRotatingFileSink::rotate()
 	buf[buf_len] = '\0';
 
 	std::string name = format(m_name_format, buf);
-
-	if (m_file.is_open())
-	{
-		m_file.close();
-	}
-	m_file.open(name, "ab+");
+	open_log_file(m_file, m_msg_writer, name);
 	m_next_rotating_time += m_duration;
-	m_msg_writer.set_write_target(&m_file);
 }
 
 
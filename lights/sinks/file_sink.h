@@ -18,6 +18,38 @@
 namespace lights {
 namespace sinks {
 
+/**
+ * LogFileFormat decides the layout of log file. File sink uses it to write file header and
+ * encode log message before write into file.
+ */
+class LogFileFormat
+{
+public:
+	virtual ~LogFileFormat() = default;
+
+	/**
+	 * Starts to write into @c file. It's call when sink open a file.
+	 * @return Returns false when cannot append to @c file, such as file is written by another
+	 *         version of format. File must be kept unchanged, and sink writes to a new file.
+	 * @note File may be not empty, because sink appends to the existing file.
+	 */
+	virtual bool begin_file(FileStream& file) = 0;
+
+	/**
+	 * Encodes log message and writes into @c file.
+	 * @return Number of bytes that write into file.
+	 */
+	virtual std::size_t write(FileStream& file, SequenceView log_msg) = 0;
+
+	/**
+	 * Returns the max number of bytes that @c write writes @c log_msg into the current file.
+	 * Sink uses it to rotate file before writing, because encoded length may differ from
+	 * length of log message.
+	 */
+	virtual std::size_t max_write_length(SequenceView log_msg) = 0;
+};
+
+
 /**
  * LogMessageWriter ensure every log message is write to backend completely.
  * And support difference policy to flush log message to backend.
@@ -27,20 +59,41 @@ class LogMessageWriter
 public:
 	/**
 	 * Creates writer.
+	 * @param format  Writes log message as it is when format is nullptr.
+	 * @throw Thrown InvalidArgument when format cannot append to @c file. Use @c set_write_target
+	 *        to handle it without exception.
 	 */
-	LogMessageWriter(FileStream* file = nullptr) :
+	LogMessageWriter(FileStream* file = nullptr, LogFileFormat* format = nullptr) :
 		m_file(file),
+		m_format(format),
 		m_buffer_length(0),
 		m_last_flush_time(0)
-	{}
+	{
+		if (m_file != nullptr && !this->set_write_target(m_file))
+		{
+			LIGHTS_THROW(InvalidArgument, "LogMessageWriter: Format cannot append to file");
+		}
+	}
 
 	/**
 	 * Sets log message write target.
+	 * @return Returns false when format cannot append to @c file, and file is unchanged.
+	 *         Caller must set another write target.
 	 */
-	void set_write_target(FileStream* file)
+	bool set_write_target(FileStream* file)
 	{
 		m_file = file;
 		m_buffer_length = 0;
+		return (m_format != nullptr) ? m_format->begin_file(*m_file) : true;
+	}
+
+	/**
+	 * Sets format of file. It's take effect at the next write target.
+	 * @note Caller must ensure lifecycle of @c format.
+	 */
+	void set_file_format(LogFileFormat* format)
+	{
+		m_format = format;
 	}
 
 	/**
@@ -48,7 +101,7 @@ public:
 	 */
 	std::size_t write(SequenceView log_msg)
 	{
-		std::size_t len = m_file->write(log_msg);
+		std::size_t len = (m_format != nullptr) ? m_format->write(*m_file, log_msg) : m_file->write(log_msg);
 		m_buffer_length += len;
 
 		if (m_buffer_length > FILE_DEFAULT_BUFFER_SIZE)
@@ -60,6 +113,14 @@ public:
 		return len;
 	}
 
+	/**
+	 * Returns the max number of bytes that @c write writes @c log_msg into backend.
+	 */
+	std::size_t max_write_length(SequenceView log_msg)
+	{
+		return (m_format != nullptr) ? m_format->max_write_length(log_msg) : log_msg.length();
+	}
+
 	/**
 	 * Flushes underlying buffer if it's been long time no flush.
 	 * Use to ensure log message to be write to file.
@@ -77,6 +138,7 @@ public:
 
 private:
 	FileStream* m_file;
+	LogFileFormat* m_format;
 	std::size_t m_buffer_length;
 	std::time_t m_last_flush_time;
 };
@@ -90,8 +152,11 @@ class SimpleFileSink: public Sink
 public:
 	/**
 	 * Creates sink.
+	 * @param file_format  Layout of file. Writes log message as it is when format is nullptr.
+	 * @note Caller must ensure lifecycle of @c file_format. When format cannot append to file,
+	 *       such as file is written by another version of format, writes into "filename.N".
 	 */
-	SimpleFileSink(StringView filename);
+	SimpleFileSink(StringView filename, LogFileFormat* file_format = nullptr);
 
 	/**
 	 * Writes log message into backend.
@@ -140,6 +205,13 @@ public:
 	 */
 	void init_max_files(std::size_t max_files);
 
+	/**
+	 * @note If not init file format, log message is write as it is.
+	 *       Caller must ensure lifecycle of @c file_format. File that format cannot append to
+	 *       is not reused.
+	 */
+	void init_file_format(LogFileFormat* file_format);
+
 	/**
 	 * Ends initialization.
 	 */
@@ -173,6 +245,7 @@ private:
 	LogMessageWriter m_msg_writer;
 	std::size_t m_index;
 	std::size_t m_current_size;
+	std::size_t m_begin_size; // Size of new file before writing log message, such as file header.
 	std::mutex m_mutex;
 };
 
@@ -189,10 +262,14 @@ public:
 	 * @param name_format  Must have a placeholder "{}" and it'll replace by rotating time.
 	 * @param duration     Within a duration, all message will log to same file.
 	 * @param day_point    The seconds of a day that will execute rotating.
+	 * @param file_format  Layout of file. Writes log message as it is when format is nullptr.
+	 * @note Caller must ensure lifecycle of @c file_format. When format cannot append to file,
+	 *       writes into "filename.N".
 	 */
 	TimeRotatingFileSink(std::string name_format,
 						 std::time_t duration = ONE_DAY_SECONDS,
-						 std::time_t day_point = 0);
+						 std::time_t day_point = 0,
+						 LogFileFormat* file_format = nullptr);
 
 	/**
 	 * Writes log message into backend.
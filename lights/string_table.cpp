@@ -7,98 +7,1219 @@
 #include "string_table.h"
 
 #include <vector>
-#include <unordered_map>
 #include <fstream>
 #include <memory>
+#include <mutex>
+#include <atomic>
+#include <new>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "config.h"
 #include "env.h"
 #include "exception.h"
+#include "file.h"
+#include "checksum.h"
 
 
 namespace lights {
 
 namespace details {
 
+/**
+ * Number of index in the first segment of string array is 2^STRING_TABLE_FIRST_SEGMENT_BITS.
+ * Size of segment is double of the previous one, so segment never moves after it's allocated.
+ */
+constexpr std::size_t STRING_TABLE_FIRST_SEGMENT_BITS = 10;
+constexpr std::size_t STRING_TABLE_MAX_SEGMENTS = 32;
+
+/**
+ * Min number of slot in hash index.
+ */
+constexpr std::size_t STRING_TABLE_MIN_INDEX_CAPACITY = 1024;
+
+/**
+ * Size of memory chunk that strings are allocated from.
+ */
+constexpr std::size_t STRING_TABLE_ARENA_CHUNK_SIZE = 64 * 1024;
+
+/**
+ * Min number of slot in hash index of image file.
+ */
+constexpr std::size_t STRING_TABLE_MIN_IMAGE_INDEX_CAPACITY = 16;
+
+/**
+ * Image file starts with null character, so it's never mistaken for text string table file.
+ */
+constexpr char STRING_TABLE_IMAGE_MAGIC[8] = {'\0', 'L', 'S', 'T', 'A', 'B', 'L', 'E'};
+constexpr std::uint32_t STRING_TABLE_IMAGE_VERSION_NATIVE_HASH = 1; // Hash of standard library.
+constexpr std::uint32_t STRING_TABLE_IMAGE_VERSION_HASH_FUNCTION = 2; // Hash function is recorded in header.
+constexpr std::uint32_t STRING_TABLE_IMAGE_VERSION = STRING_TABLE_IMAGE_VERSION_HASH_FUNCTION;
+
+/**
+ * Hash function that is recorded in image header.
+ */
+constexpr std::uint32_t STRING_TABLE_HASH_FNV1A_64 = 1;
+
+constexpr std::uint64_t FNV1A_64_OFFSET_BASIS = 14695981039346656037ULL;
+constexpr std::uint64_t FNV1A_64_PRIME = 1099511628211ULL;
+
+/**
+ * Offset of reserve index that have no string.
+ */
+constexpr std::uint64_t STRING_TABLE_INVALID_OFFSET = static_cast<std::uint64_t>(-1);
+
+constexpr std::size_t STRING_TABLE_NOT_FOUND = static_cast<std::size_t>(-1);
+
+/**
+ * Returns position of the highest bit of @c n that is not zero.
+ */
+inline std::size_t highest_bit(std::uint64_t n)
+{
+#if defined(__GNUC__)
+	return 63 - static_cast<std::size_t>(__builtin_clzll(n));
+#else
+	std::size_t bit = 0;
+	while (n >>= 1)
+	{
+		++bit;
+	}
+	return bit;
+#endif
+}
+
+
+/**
+ * Returns FNV-1a 64 hash of string that is use by all hash index of string table. Hash is
+ * saved in image, so it must be the same in any platform and standard library.
+ */
+inline std::uint64_t hash_str(StringView str)
+{
+	std::uint64_t hash = FNV1A_64_OFFSET_BASIS;
+	for (std::size_t i = 0; i < str.length(); ++i)
+	{
+		hash ^= static_cast<std::uint8_t>(str[i]);
+		hash *= FNV1A_64_PRIME;
+	}
+	return hash;
+}
+
+
+/**
+ * Returns hash of string that is use by image of version 1.
+ */
+inline std::uint64_t native_hash_str(StringView str)
+{
+	return env::hash(str.data(), str.length());
+}
+
+
+/**
+ * Returns tag of hash that is recorded in slot of hash index.
+ */
+inline std::uint32_t hash_tag(std::uint64_t hash)
+{
+	return static_cast<std::uint32_t>(hash ^ (hash >> 32));
+}
+
+
+/**
+ * Makes slot of hash index.
+ */
+inline std::uint64_t make_index_slot(std::uint64_t hash, std::size_t index)
+{
+	return (static_cast<std::uint64_t>(hash_tag(hash)) << 32) | (index + 1);
+}
+
+
+/**
+ * Header of string table image file.
+ * @details Image file is header, entry array, hash index and then string blob. Image file is
+ *          mapped and use directly, so all field is native byte order and aligned by itself.
+ *          Hash index is the same as StringTableIndex.
+ */
+struct StringTableImageHeader
+{
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t count; // Number of index, include the reserve index.
+	std::uint64_t index_capacity; // Power of 2.
+	std::uint64_t blob_length;
+	std::uint32_t hash_function; // Since version 2.
+	std::uint32_t reserved;
+};
+
+
+/**
+ * Returns length of image header, header of version 1 has no hash function.
+ */
+inline std::size_t get_image_header_length(const StringTableImageHeader& header)
+{
+	if (header.version == STRING_TABLE_IMAGE_VERSION_NATIVE_HASH)
+	{
+		return offsetof(StringTableImageHeader, hash_function);
+	}
+	return sizeof(StringTableImageHeader);
+}
+
+
+struct StringTableImageEntry
+{
+	std::uint64_t hash;
+	std::uint64_t offset; // Offset of string in blob.
+	std::uint64_t length;
+};
+
+
+/**
+ * Returns length of image that is describe by @c header.
+ * @return Returns zero when header is invalid or image is longer than @c file_size.
+ */
+std::size_t get_image_length(const StringTableImageHeader& header, std::size_t file_size)
+{
+	if (std::memcmp(header.magic, STRING_TABLE_IMAGE_MAGIC, sizeof(header.magic)) != 0 ||
+		(header.version != STRING_TABLE_IMAGE_VERSION_NATIVE_HASH &&
+		 !(header.version == STRING_TABLE_IMAGE_VERSION_HASH_FUNCTION && header.hash_function == STRING_TABLE_HASH_FNV1A_64)) ||
+		file_size < get_image_header_length(header))
+	{
+		return 0;
+	}
+
+	// Checks each part one by one, so computing length never overflows.
+	std::size_t header_length = get_image_header_length(header);
+	std::size_t remain = file_size - header_length;
+	std::uint64_t capacity = header.index_capacity;
+	if (header.count > remain / sizeof(StringTableImageEntry) ||
+		capacity == 0 || (capacity & (capacity - 1)) != 0 || capacity <= header.count ||
+		capacity > (remain - header.count * sizeof(StringTableImageEntry)) / sizeof(std::uint64_t) ||
+		header.blob_length > remain - header.count * sizeof(StringTableImageEntry) - capacity * sizeof(std::uint64_t))
+	{
+		return 0;
+	}
+	return header_length + header.count * sizeof(StringTableImageEntry) +
+		static_cast<std::size_t>(capacity * sizeof(std::uint64_t) + header.blob_length);
+}
+
+
+/**
+ * Header of record that appends string after image.
+ */
+struct StringTableRecordHeader
+{
+	std::uint32_t index;
+	std::uint32_t length;
+	std::uint32_t checksum; // CRC32C of index, length and string.
+};
+
+
+inline std::uint32_t str_record_checksum(const StringTableRecordHeader& header, StringView str)
+{
+	return crc32c(SequenceView(str.data(), str.length()),
+				  crc32c(SequenceView(&header, sizeof(header.index) + sizeof(header.length))));
+}
+
+
+/**
+ * Reads record at the beginning of @c data.
+ * @return Returns length of record, or zero when record is incomplete or broken.
+ */
+std::size_t read_str_record(SequenceView data, std::size_t& index, StringView& str)
+{
+	StringTableRecordHeader header;
+	if (data.length() < sizeof(header))
+	{
+		return 0;
+	}
+
+	std::memcpy(&header, data.data(), sizeof(header));
+	if (header.length > data.length() - sizeof(header))
+	{
+		return 0;
+	}
+
+	str = StringView(static_cast<const char*>(data.data()) + sizeof(header), header.length);
+	if (str_record_checksum(header, str) != header.checksum)
+	{
+		return 0;
+	}
+	index = header.index;
+	return sizeof(header) + header.length;
+}
+
+
+/**
+ * Appends record of string into @c buffer.
+ */
+void append_str_record(std::string& buffer, std::size_t index, StringView str)
+{
+	StringTableRecordHeader header;
+	header.index = static_cast<std::uint32_t>(index);
+	header.length = static_cast<std::uint32_t>(str.length());
+	header.checksum = str_record_checksum(header, str);
+	buffer.append(reinterpret_cast<const char*>(&header), sizeof(header));
+	buffer.append(str.data(), str.length());
+}
+
+
+/**
+ * StringTableImage is a read only string table that is mapped from image file.
+ */
+class StringTableImage
+{
+public:
+	StringTableImage() :
+		m_file(),
+		m_tail(nullptr, 0),
+		m_entries(nullptr),
+		m_slots(nullptr),
+		m_index_capacity(0),
+		m_blob(nullptr),
+		m_blob_length(0),
+		m_count(0),
+		m_native_hash(false)
+	{}
+
+	/**
+	 * Maps image file.
+	 * @throw Thrown OpenFileError when cannot open file, and InvalidArgument when file is broken.
+	 */
+	void open(StringView filename);
+
+	/**
+	 * Returns number of index, include the reserve index.
+	 */
+	std::size_t size() const
+	{
+		return m_count;
+	}
+
+	/**
+	 * Gets string by index.
+	 * @note Return nullptr if index is invalid or reserve.
+	 */
+	StringView get_str(std::size_t index) const;
+
+	/**
+	 * Finds index of string.
+	 * @return Returns STRING_TABLE_NOT_FOUND when cannot find string.
+	 */
+	std::size_t find(StringView str, std::uint64_t hash) const;
+
+	/**
+	 * Returns content of file after image when file is mapped.
+	 */
+	SequenceView tail() const
+	{
+		return m_tail;
+	}
+
+private:
+	std::unique_ptr<MappedFileStream> m_file;
+	SequenceView m_tail;
+	const StringTableImageEntry* m_entries;
+	const std::uint64_t* m_slots;
+	std::size_t m_index_capacity;
+	const char* m_blob;
+	std::size_t m_blob_length;
+	std::size_t m_count;
+	bool m_native_hash; // Image of version 1 uses hash of standard library.
+};
+
+
+void StringTableImage::open(StringView filename)
+{
+	m_file.reset(new MappedFileStream(filename));
+	std::size_t file_size = m_file->size();
+	if (file_size < sizeof(StringTableImageHeader))
+	{
+		LIGHTS_THROW(InvalidArgument, "StringTable: Image file is too short");
+	}
+
+	SequenceView content = m_file->view(0, file_size);
+	auto data = static_cast<const char*>(content.data());
+	auto header = reinterpret_cast<const StringTableImageHeader*>(data);
+	std::size_t image_length = get_image_length(*header, file_size);
+	if (image_length == 0)
+	{
+		LIGHTS_THROW(InvalidArgument, "StringTable: Invalid image file");
+	}
+
+	m_tail = SequenceView(data + image_length, file_size - image_length);
+	m_count = header->count;
+	m_index_capacity = static_cast<std::size_t>(header->index_capacity);
+	m_blob_length = static_cast<std::size_t>(header->blob_length);
+	m_native_hash = (header->version == STRING_TABLE_IMAGE_VERSION_NATIVE_HASH);
+	m_entries = reinterpret_cast<const StringTableImageEntry*>(data + get_image_header_length(*header));
+	m_slots = reinterpret_cast<const std::uint64_t*>(m_entries + m_count);
+	m_blob = reinterpret_cast<const char*>(m_slots + m_index_capacity);
+	m_file->advise(MappedFileAdvice::RANDOM);
+}
+
+
+inline StringView StringTableImage::get_str(std::size_t index) const
+{
+	if (index >= m_count)
+	{
+		return invalid_string_view();
+	}
+
+	const StringTableImageEntry& entry = m_entries[index];
+	if (entry.offset == STRING_TABLE_INVALID_OFFSET ||
+		entry.offset > m_blob_length || entry.length > m_blob_length - entry.offset)
+	{
+		return invalid_string_view();
+	}
+	return StringView(m_blob + entry.offset, static_cast<std::size_t>(entry.length));
+}
+
+
+std::size_t StringTableImage::find(StringView str, std::uint64_t hash) const
+{
+	if (m_count == 0)
+	{
+		return STRING_TABLE_NOT_FOUND;
+	}
+
+	if (m_native_hash)
+	{
+		hash = native_hash_str(str);
+	}
+
+	std::size_t mask = m_index_capacity - 1;
+	std::uint32_t tag = hash_tag(hash);
+	// Probes at most capacity slots, so broken index that is full never loops forever.
+	for (std::size_t i = 0, pos = hash & mask; i < m_index_capacity; ++i, pos = (pos + 1) & mask)
+	{
+		std::uint64_t slot = m_slots[pos];
+		if (slot == 0)
+		{
+			break;
+		}
+
+		std::size_t str_index = static_cast<std::size_t>(slot & 0xFFFFFFFF) - 1;
+		if (static_cast<std::uint32_t>(slot >> 32) == tag && str_index < m_count &&
+			m_entries[str_index].hash == hash)
+		{
+			StringView candidate = get_str(str_index);
+			if (is_valid(candidate) && candidate.length() == str.length() &&
+				std::memcmp(candidate.data(), str.data(), str.length()) == 0)
+			{
+				return str_index;
+			}
+		}
+	}
+	return STRING_TABLE_NOT_FOUND;
+}
+
+
+/**
+ * StringEntry is place in front of characters of string in arena.
+ */
+struct StringEntry
+{
+	StringView str;
+	std::uint64_t hash;
+};
+
+
+/**
+ * StringArena allocates memory from large chunks, and all memory is free together.
+ * @note It's not thread safe.
+ */
+class StringArena
+{
+public:
+	StringArena() :
+		m_chunks(),
+		m_current(nullptr),
+		m_remain(0)
+	{}
+
+	/**
+	 * Allocates memory that is aligned as StringEntry.
+	 */
+	void* allocate(std::size_t size)
+	{
+		size = (size + alignof(StringEntry) - 1) / alignof(StringEntry) * alignof(StringEntry);
+		if (size > m_remain)
+		{
+			// Large allocation uses its own chunk, so the remaining space of current chunk is not waste.
+			if (size > STRING_TABLE_ARENA_CHUNK_SIZE / 4)
+			{
+				m_chunks.emplace_back(new char[size]);
+				return m_chunks.back().get();
+			}
+			m_chunks.emplace_back(new char[STRING_TABLE_ARENA_CHUNK_SIZE]);
+			m_current = m_chunks.back().get();
+			m_remain = STRING_TABLE_ARENA_CHUNK_SIZE;
+		}
+
+		void* memory = m_current;
+		m_current += size;
+		m_remain -= size;
+		return memory;
+	}
+
+private:
+	std::vector<std::unique_ptr<char[]>> m_chunks; // Memory of new char[] is aligned for any fundamental type.
+	char* m_current;
+	std::size_t m_remain;
+};
+
+
+/**
+ * StringTableIndex is an open addressing hash index of string.
+ * @details Slot records hash tag at high 32 bits and index + 1 at low 32 bits, zero is empty slot.
+ *          Slot is only write by writer and can be read without lock.
+ */
+struct StringTableIndex
+{
+	explicit StringTableIndex(std::size_t capacity) :
+		capacity(capacity),
+		slots(new std::atomic<std::uint64_t>[capacity]())
+	{}
+
+	std::size_t capacity; // Power of 2.
+	std::unique_ptr<std::atomic<std::uint64_t>[]> slots;
+};
+
+
+/**
+ * StringTableImpl finds strings in mapped image first, and stores new strings in append-only
+ * segments that are found by hash index.
+ * @details String and its entry are allocated together from arena. Segments, index and arena
+ *          are only created when the first string is added, so table that is loaded from image
+ *          and never adds string costs nothing more than mapping.
+ *          Reader never locks. Writer is serialized by mutex and publishes string before index
+ *          and size with release order, so reader that sees index or size also sees string.
+ *          Index is replaced when it grows, and the old one is kept until destruction because
+ *          reader may still probe it. Reader that misses a new string in old index will find it
+ *          again with lock.
+ */
 struct StringTableImpl
 {
-	struct StringHash
+	using Entry = std::atomic<const StringEntry*>;
+
+	StringTableImpl();
+
+	~StringTableImpl();
+
+	StringView get_str(std::size_t index) const;
+
+	/**
+	 * Finds index of string without lock.
+	 * @return Returns STRING_TABLE_NOT_FOUND when cannot find string.
+	 */
+	std::size_t find(StringView str, std::uint64_t hash) const;
+
+	/**
+	 * Adds string at the end.
+	 * @note Must hold the mutex.
+	 */
+	std::size_t add_str(StringView str, std::uint64_t hash);
+
+	/**
+	 * Stores string at @c index and puts it into hash index.
+	 * @note Must hold the mutex.
+	 */
+	void store_str(std::size_t index, StringView str, std::uint64_t hash);
+
+	Entry& entry(std::size_t index) const;
+
+	/**
+	 * Returns entry of string that is added after loading.
+	 * @note Returns nullptr when there is no string at @c index.
+	 */
+	const StringEntry* load_entry(std::size_t index) const;
+
+	void insert_index(std::uint64_t hash, std::size_t index);
+
+	/**
+	 * Saves all strings into image file. Image is written to temporary file and then replaces
+	 * @c filename, so mapping of the old image is still valid.
+	 * @return Returns false when cannot write file.
+	 */
+	bool save_image(const std::string& filename) const;
+
+	/**
+	 * Puts strings of records into table.
+	 * @return Returns length of complete records.
+	 */
+	std::size_t load_records(SequenceView records);
+
+	/**
+	 * Writes pending strings into file as record.
+	 */
+	bool flush();
+
+	/**
+	 * Locks file of @c filename by a lock file beside it, so only one string table writes it.
+	 * Lock file is not remove, because removing it may let two string table hold lock of
+	 * different file.
+	 * @return Returns false when file is locked by another string table.
+	 */
+	bool lock_storage();
+
+	/**
+	 * Opens file to append records. Broken record at the end of file that is left by crash
+	 * is removed, and records that append by the previous writer are kept.
+	 */
+	bool open_storage();
+
+	/**
+	 * Checks file of @c filename is image.
+	 */
+	bool is_image_file() const;
+
+	/**
+	 * Puts strings back to pending when they fail to write.
+	 */
+	void restore_pending(const std::vector<std::size_t>& indexes);
+
+	/**
+	 * Checks opened file is still the file of @c filename. It's not when file is replaced by
+	 * merging of others.
+	 */
+	bool is_storage_current() const;
+
+	/**
+	 * Reads all records after image from opened file.
+	 */
+	bool read_storage_records(std::string& records, std::size_t& image_length);
+
+	/**
+	 * Merges records into image, so the next loading only maps file.
+	 * @details Records are read from file again, so records that are not loaded are merged too.
+	 *          File is not replaced when it's not the file that string table appends to, because
+	 *          it's replaced by others already.
+	 */
+	bool merge_image();
+
+	bool write_storage(SequenceView data);
+
+	static std::int64_t steady_now();
+
+	StringTableImage image;
+	std::atomic<Entry*> segments[STRING_TABLE_MAX_SEGMENTS];
+	std::atomic<std::size_t> size;
+	std::atomic<StringTableIndex*> index;
+	std::vector<std::unique_ptr<StringTableIndex>> indexes; // The last one is current index.
+	std::size_t index_count;
+	StringArena arena;
+	std::mutex mutex; // Serializes writer.
+	std::string filename;
+	bool persistent = false; // New string is pending to write into file.
+	StringTableFlushPolicy flush_policy;
+	std::vector<std::size_t> pending; // Index of strings that are not written into file. Protected by mutex.
+	std::atomic<std::size_t> pending_count;
+	std::atomic<std::int64_t> first_pending_time; // Nanoseconds of steady clock.
+	std::mutex flush_mutex; // Serializes writing file.
+	std::string flush_buffer;
+	int storage_fd = -1;
+	int lock_fd = -1; // Holds lock of file until destruction.
+	bool appended = false; // Records are appended by this string table.
+};
+
+
+StringTableImpl::StringTableImpl() :
+	image(),
+	size(0),
+	index(nullptr),
+	indexes(),
+	index_count(0),
+	arena(),
+	pending_count(0),
+	first_pending_time(0)
+{
+	for (auto& segment : segments)
+	{
+		segment.store(nullptr, std::memory_order_relaxed);
+	}
+}
+
+
+StringTableImpl::~StringTableImpl()
+{
+	if (storage_fd != -1)
+	{
+		::close(storage_fd);
+	}
+
+	if (lock_fd != -1)
+	{
+		::close(lock_fd);
+	}
+
+	for (auto& segment : segments)
+	{
+		delete[] segment.load(std::memory_order_acquire);
+	}
+}
+
+
+inline StringTableImpl::Entry& StringTableImpl::entry(std::size_t index) const
+{
+	std::size_t position = (index >> STRING_TABLE_FIRST_SEGMENT_BITS) + 1;
+	std::size_t segment = highest_bit(position);
+	std::size_t offset = index - (((std::size_t(1) << segment) - 1) << STRING_TABLE_FIRST_SEGMENT_BITS);
+	return segments[segment].load(std::memory_order_acquire)[offset];
+}
+
+
+inline const StringEntry* StringTableImpl::load_entry(std::size_t index) const
+{
+	std::size_t position = (index >> STRING_TABLE_FIRST_SEGMENT_BITS) + 1;
+	std::size_t segment = highest_bit(position);
+	const Entry* entries = segments[segment].load(std::memory_order_acquire);
+	if (entries == nullptr)
 	{
-		size_t operator()(StringView str) const noexcept
+		return nullptr;
+	}
+	std::size_t offset = index - (((std::size_t(1) << segment) - 1) << STRING_TABLE_FIRST_SEGMENT_BITS);
+	return entries[offset].load(std::memory_order_acquire);
+}
+
+
+inline StringView StringTableImpl::get_str(std::size_t index) const
+{
+	if (index >= size.load(std::memory_order_acquire))
+	{
+		return invalid_string_view();
+	}
+
+	// String of image may be replaced by entry.
+	const StringEntry* str_entry = load_entry(index);
+	if (str_entry != nullptr)
+	{
+		return str_entry->str;
+	}
+	return (index < image.size()) ? image.get_str(index) : invalid_string_view();
+}
+
+
+std::size_t StringTableImpl::find(StringView str, std::uint64_t hash) const
+{
+	std::size_t image_index = image.find(str, hash);
+	if (image_index != STRING_TABLE_NOT_FOUND && load_entry(image_index) == nullptr)
+	{
+		return image_index;
+	}
+
+	const StringTableIndex* table = index.load(std::memory_order_acquire);
+	if (table == nullptr)
+	{
+		return STRING_TABLE_NOT_FOUND;
+	}
+
+	std::size_t mask = table->capacity - 1;
+	std::uint32_t tag = hash_tag(hash);
+	for (std::size_t pos = hash & mask; ; pos = (pos + 1) & mask)
+	{
+		std::uint64_t slot = table->slots[pos].load(std::memory_order_acquire);
+		if (slot == 0)
+		{
+			return STRING_TABLE_NOT_FOUND;
+		}
+
+		if (static_cast<std::uint32_t>(slot >> 32) == tag)
 		{
-			return env::hash(str.data(), str.length());
+			std::size_t str_index = static_cast<std::size_t>(slot & 0xFFFFFFFF) - 1;
+			const StringEntry* candidate = entry(str_index).load(std::memory_order_acquire);
+			if (candidate->hash == hash &&
+				candidate->str.length() == str.length() &&
+				std::memcmp(candidate->str.data(), str.data(), str.length()) == 0)
+			{
+				return str_index;
+			}
 		}
-	};
+	}
+}
+
 
-	struct StringEqualTo
+std::size_t StringTableImpl::add_str(StringView str, std::uint64_t hash)
+{
+	std::size_t str_index = size.load(std::memory_order_relaxed);
+	this->store_str(str_index, str, hash);
+	return str_index;
+}
+
+
+void StringTableImpl::store_str(std::size_t str_index, StringView str, std::uint64_t hash)
+{
+	std::size_t position = (str_index >> STRING_TABLE_FIRST_SEGMENT_BITS) + 1;
+	std::size_t last_segment = highest_bit(position);
+	if (last_segment >= STRING_TABLE_MAX_SEGMENTS || str_index >= 0xFFFFFFFF)
+	{
+		LIGHTS_THROW(InvalidArgument, "StringTable: Too many strings");
+	}
+	for (std::size_t i = 0; i <= last_segment; ++i)
+	{
+		if (segments[i].load(std::memory_order_relaxed) == nullptr)
+		{
+			std::size_t segment_size = std::size_t(1) << (i + STRING_TABLE_FIRST_SEGMENT_BITS);
+			segments[i].store(new Entry[segment_size](), std::memory_order_release);
+		}
+	}
+
+	void* memory = arena.allocate(sizeof(StringEntry) + str.length());
+	char* storage = static_cast<char*>(memory) + sizeof(StringEntry);
+	copy_array(storage, str.data(), str.length());
+	auto str_entry = new(memory) StringEntry{StringView(storage, str.length()), hash};
+	entry(str_index).store(str_entry, std::memory_order_release);
+	if (persistent)
 	{
-		bool operator()(StringView lhs, StringView rhs) const noexcept
+		if (pending.empty())
 		{
-			if (lhs.length() != rhs.length())
+			first_pending_time.store(steady_now(), std::memory_order_relaxed);
+		}
+		pending.push_back(str_index);
+		pending_count.store(pending.size(), std::memory_order_release);
+	}
+	if (str_index >= size.load(std::memory_order_relaxed))
+	{
+		size.store(str_index + 1, std::memory_order_release);
+	}
+
+	// The first string is found when there are the same strings.
+	if (this->find(str, hash) == STRING_TABLE_NOT_FOUND)
+	{
+		this->insert_index(hash, str_index);
+	}
+}
+
+
+void StringTableImpl::insert_index(std::uint64_t hash, std::size_t str_index)
+{
+	StringTableIndex* table = index.load(std::memory_order_relaxed);
+	if (table == nullptr)
+	{
+		indexes.emplace_back(new StringTableIndex(STRING_TABLE_MIN_INDEX_CAPACITY));
+		table = indexes.back().get();
+		index.store(table, std::memory_order_release);
+	}
+
+	if ((index_count + 1) * 2 > table->capacity)
+	{
+		// Rehashes into a larger index, and old index is kept for reader.
+		std::unique_ptr<StringTableIndex> new_table(new StringTableIndex(table->capacity * 2));
+		std::size_t mask = new_table->capacity - 1;
+		for (std::size_t i = 0; i < table->capacity; ++i)
+		{
+			std::uint64_t slot = table->slots[i].load(std::memory_order_relaxed);
+			if (slot != 0)
 			{
-				return false;
+				std::size_t str_index = static_cast<std::size_t>(slot & 0xFFFFFFFF) - 1;
+				std::size_t pos = entry(str_index).load(std::memory_order_relaxed)->hash & mask;
+				while (new_table->slots[pos].load(std::memory_order_relaxed) != 0)
+				{
+					pos = (pos + 1) & mask;
+				}
+				new_table->slots[pos].store(slot, std::memory_order_relaxed);
 			}
-			else
+		}
+		table = new_table.get();
+		indexes.push_back(std::move(new_table));
+		index.store(table, std::memory_order_release);
+	}
+
+	std::size_t mask = table->capacity - 1;
+	std::size_t pos = hash & mask;
+	while (table->slots[pos].load(std::memory_order_relaxed) != 0)
+	{
+		pos = (pos + 1) & mask;
+	}
+	table->slots[pos].store(make_index_slot(hash, str_index), std::memory_order_release);
+	++index_count;
+}
+
+
+bool StringTableImpl::save_image(const std::string& filename) const
+{
+	std::size_t count = size.load(std::memory_order_acquire);
+	std::size_t capacity = STRING_TABLE_MIN_IMAGE_INDEX_CAPACITY;
+	while (capacity < count * 2)
+	{
+		capacity *= 2;
+	}
+
+	std::vector<StringTableImageEntry> entries(count);
+	std::unique_ptr<std::uint64_t[]> slots(new std::uint64_t[capacity]());
+	std::size_t mask = capacity - 1;
+	std::uint64_t blob_length = 0;
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		StringView str = get_str(i);
+		if (!is_valid(str))
+		{
+			entries[i] = StringTableImageEntry{0, STRING_TABLE_INVALID_OFFSET, 0};
+			continue;
+		}
+
+		std::uint64_t hash = hash_str(str);
+		entries[i] = StringTableImageEntry{hash, blob_length, str.length()};
+		blob_length += str.length();
+
+		// Only the first string is found when there are the same strings.
+		if (find(str, hash) == i)
+		{
+			std::size_t pos = hash & mask;
+			while (slots[pos] != 0)
 			{
-				return std::memcmp(lhs.data(), rhs.data(), rhs.length()) == 0;
+				pos = (pos + 1) & mask;
 			}
+			slots[pos] = make_index_slot(hash, i);
 		}
-	};
+	}
 
-	std::fstream storage_file;
-	std::size_t last_index = static_cast<std::size_t>(-1);
-	std::vector<StringView> str_array; // To generate index.
-	std::unordered_map<StringView,
-					   std::uint32_t, // index of str_array.
-					   StringHash,
-					   StringEqualTo> str_hash; // To find faster.
-};
+	StringTableImageHeader header;
+	copy_array(header.magic, STRING_TABLE_IMAGE_MAGIC);
+	header.version = STRING_TABLE_IMAGE_VERSION;
+	header.count = static_cast<std::uint32_t>(count);
+	header.index_capacity = capacity;
+	header.blob_length = blob_length;
+	header.hash_function = STRING_TABLE_HASH_FNV1A_64;
+	header.reserved = 0;
 
-} // namespace details
+	std::string temp_filename = filename + ".tmp";
+	std::ofstream file(temp_filename, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(entries.data()), count * sizeof(StringTableImageEntry));
+	file.write(reinterpret_cast<const char*>(slots.get()), capacity * sizeof(std::uint64_t));
+	for (std::size_t i = 0; file && i < count; ++i)
+	{
+		StringView str = get_str(i);
+		if (is_valid(str))
+		{
+			file.write(str.data(), str.length());
+		}
+	}
+	file.close();
+
+	if (!file || std::rename(temp_filename.c_str(), filename.c_str()) != 0)
+	{
+		std::remove(temp_filename.c_str());
+		return false;
+	}
+	return true;
+}
 
 
-StringTable::StringTable(StringView filename):
-	p_impl(new ImplementType())
+std::size_t StringTableImpl::load_records(SequenceView records)
 {
-	p_impl->storage_file.open(filename.data());
-	if (p_impl->storage_file.is_open())
+	auto data = static_cast<const char*>(records.data());
+	std::size_t offset = 0;
+	std::size_t str_index;
+	StringView str = invalid_string_view();
+	while (std::size_t record_length = read_str_record(
+		SequenceView(data + offset, records.length() - offset), str_index, str))
 	{
-		std::string line;
-		while (std::getline(p_impl->storage_file, line))
+		// Record is written again when it's fail to write before, so it may be duplicate.
+		if (!is_valid(get_str(str_index)))
 		{
-			add_str(StringView(line.c_str(), line.length()));
+			store_str(str_index, str, hash_str(str));
 		}
-		p_impl->last_index = p_impl->str_array.size() - 1;
+		offset += record_length;
 	}
-	else
+	return offset;
+}
+
+
+bool StringTableImpl::flush()
+{
+	std::lock_guard<std::mutex> flush_lock(flush_mutex);
+	std::vector<std::size_t> indexes;
 	{
-		p_impl->storage_file.open(filename.data(), std::ios_base::out); // Create file.
-		if (!p_impl->storage_file.is_open())
+		std::lock_guard<std::mutex> lock(mutex);
+		indexes.swap(pending);
+		pending_count.store(0, std::memory_order_release);
+	}
+	if (indexes.empty())
+	{
+		return true;
+	}
+
+	flush_buffer.clear();
+	for (std::size_t str_index : indexes)
+	{
+		// String that too long to record is only saved into image.
+		StringView str = get_str(str_index);
+		if (str.length() <= 0xFFFFFFFF)
 		{
-			LIGHTS_THROW(OpenFileError, filename);
+			append_str_record(flush_buffer, str_index, str);
+		}
+	}
+
+	// Records must append to the file that others merge into.
+	if (storage_fd != -1 && !this->is_storage_current())
+	{
+		::close(storage_fd);
+		storage_fd = -1;
+	}
+
+	bool converted = false;
+	if (storage_fd == -1 && !this->open_storage())
+	{
+		// Text file or file that not exists is converted to image when the first string is
+		// written, and image already includes pending strings.
+		converted = !this->is_image_file() && this->save_image(filename) && this->open_storage();
+		if (!converted)
+		{
+			this->restore_pending(indexes);
+			return false;
 		}
 	}
+
+	if ((converted || write_storage(SequenceView(flush_buffer.data(), flush_buffer.length()))) &&
+		(!flush_policy.sync || ::fdatasync(storage_fd) == 0))
+	{
+		appended = appended || (!converted && !flush_buffer.empty());
+		return true;
+	}
+
+	this->restore_pending(indexes);
+	return false;
 }
 
 
-StringTable::~StringTable()
+bool StringTableImpl::is_image_file() const
+{
+	std::ifstream file(filename, std::ios_base::in | std::ios_base::binary);
+	char magic[sizeof(STRING_TABLE_IMAGE_MAGIC)];
+	return file.read(magic, sizeof(magic)) && std::memcmp(magic, STRING_TABLE_IMAGE_MAGIC, sizeof(magic)) == 0;
+}
+
+
+void StringTableImpl::restore_pending(const std::vector<std::size_t>& indexes)
 {
-	if (p_impl->storage_file.is_open())
+	// Keeps strings pending, so they are written next time.
+	std::lock_guard<std::mutex> lock(mutex);
+	pending.insert(pending.begin(), indexes.begin(), indexes.end());
+	pending_count.store(pending.size(), std::memory_order_release);
+}
+
+
+bool StringTableImpl::lock_storage()
+{
+	// Cannot create lock file is the same as cannot write string table file, and it's
+	// reported when flush.
+	std::string lock_filename = filename + ".lock";
+	lock_fd = ::open(lock_filename.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (lock_fd == -1)
+	{
+		return true;
+	}
+
+	int ret;
+	while ((ret = ::flock(lock_fd, LOCK_EX | LOCK_NB)) != 0 && errno == EINTR)
+	{
+	}
+	if (ret != 0 && errno == EWOULDBLOCK)
 	{
-		p_impl->storage_file.seekp(0, std::ios_base::end);
-		p_impl->storage_file.clear();
-		for (std::size_t i = p_impl->last_index + 1; p_impl->storage_file && i < p_impl->str_array.size(); ++i)
+		::close(lock_fd);
+		lock_fd = -1;
+		return false;
+	}
+	return true;
+}
+
+
+bool StringTableImpl::open_storage()
+{
+	storage_fd = ::open(filename.c_str(), O_RDWR | O_APPEND | O_CLOEXEC);
+	if (storage_fd == -1)
+	{
+		return false;
+	}
+
+	// Checks all records, because the previous writer may leave broken record when it crashes.
+	std::string records;
+	std::size_t image_length;
+	if (!this->read_storage_records(records, image_length))
+	{
+		::close(storage_fd);
+		storage_fd = -1;
+		return false;
+	}
+
+	std::size_t offset = 0;
+	std::size_t str_index;
+	StringView str = invalid_string_view();
+	while (std::size_t record_length = read_str_record(
+		SequenceView(records.data() + offset, records.length() - offset), str_index, str))
+	{
+		offset += record_length;
+	}
+	if (offset != records.length() && ::ftruncate(storage_fd, image_length + offset) != 0)
+	{
+		::close(storage_fd);
+		storage_fd = -1;
+		return false;
+	}
+	return true;
+}
+
+
+bool StringTableImpl::read_storage_records(std::string& records, std::size_t& image_length)
+{
+	struct stat file_stat;
+	StringTableImageHeader header;
+	if (::fstat(storage_fd, &file_stat) != 0 ||
+		::pread(storage_fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)))
+	{
+		return false;
+	}
+
+	image_length = get_image_length(header, static_cast<std::size_t>(file_stat.st_size));
+	if (image_length == 0)
+	{
+		return false;
+	}
+
+	records.assign(static_cast<std::size_t>(file_stat.st_size) - image_length, '\0');
+	return records.empty() ||
+		::pread(storage_fd, &records[0], records.length(), image_length) == static_cast<ssize_t>(records.length());
+}
+
+
+bool StringTableImpl::is_storage_current() const
+{
+	struct stat storage_stat;
+	struct stat file_stat;
+	return storage_fd != -1 &&
+		::fstat(storage_fd, &storage_stat) == 0 &&
+		::stat(filename.c_str(), &file_stat) == 0 &&
+		storage_stat.st_dev == file_stat.st_dev &&
+		storage_stat.st_ino == file_stat.st_ino;
+}
+
+
+bool StringTableImpl::merge_image()
+{
+	if (!this->is_storage_current())
+	{
+		return false;
+	}
+
+	std::string records;
+	std::size_t image_length;
+	if (!this->read_storage_records(records, image_length))
+	{
+		return false;
+	}
+	this->load_records(SequenceView(records.data(), records.length()));
+	return this->save_image(filename);
+}
+
+
+bool StringTableImpl::write_storage(SequenceView data)
+{
+	auto bytes = static_cast<const char*>(data.data());
+	std::size_t written = 0;
+	while (written < data.length())
+	{
+		ssize_t length = ::write(storage_fd, bytes + written, data.length() - written);
+		if (length < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (length <= 0)
 		{
-			StringView str = p_impl->str_array[i];
-			p_impl->storage_file.write(str.data(), str.length());
-			p_impl->storage_file << env::end_line();
+			// Reopens file, so broken record is removed before writing again.
+			::close(storage_fd);
+			storage_fd = -1;
+			return false;
 		}
-		p_impl->storage_file.close();
+		written += static_cast<std::size_t>(length);
 	}
+	return true;
+}
+
+
+inline std::int64_t StringTableImpl::steady_now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+/**
+ * Generates unique id of string table.
+ */
+std::size_t generate_string_table_id()
+{
+	static std::atomic<std::size_t> last_id(0);
+	return ++last_id;
+}
+
+} // namespace details
+
+
+StringTable::StringTable():
+	p_impl(new ImplementType()),
+	m_id(details::generate_string_table_id())
+{
+}
+
 
-	for (auto& str : p_impl->str_array)
+StringTable::StringTable(StringView filename, StringTableOpenMode mode):
+	p_impl(new ImplementType()),
+	m_id(details::generate_string_table_id())
+{
+	std::unique_ptr<ImplementType> guard(p_impl);
+	p_impl->filename = filename.to_std_string();
+	// Index of new string is decided when it's added, so two writers give the same index to
+	// different strings and cannot be fixed when write file.
+	if (mode == StringTableOpenMode::READ_WRITE && !p_impl->lock_storage())
+	{
+		LIGHTS_THROW(InvalidArgument, "StringTable: File is written by another string table");
+	}
+	if (p_impl->is_image_file())
+	{
+		p_impl->image.open(filename);
+		p_impl->size.store(p_impl->image.size(), std::memory_order_release);
+		p_impl->load_records(p_impl->image.tail());
+	}
+	else
 	{
-		delete[] str.data();
+		// Text file that records one string per line. File that not exist is the same as empty
+		// in read write mode.
+		std::ifstream file(p_impl->filename);
+		if (!file.is_open() && mode == StringTableOpenMode::READ_ONLY)
+		{
+			LIGHTS_THROW(OpenFileError, filename);
+		}
+
+		std::string line;
+		while (file.is_open() && std::getline(file, line))
+		{
+			StringView str(line.c_str(), line.length());
+			p_impl->add_str(str, details::hash_str(str));
+		}
+	}
+	p_impl->persistent = (mode == StringTableOpenMode::READ_WRITE);
+	guard.release();
+}
+
+
+StringTable::~StringTable()
+{
+	if (p_impl->persistent)
+	{
+		// Only the string table that appends records merges them, so string table that only
+		// reads never replaces file that is appending by others.
+		p_impl->flush();
+		p_impl->persistent = false;
+		if (p_impl->appended)
+		{
+			p_impl->merge_image();
+		}
 	}
 
 	delete p_impl;
@@ -107,41 +1228,108 @@ StringTable::~StringTable()
 
 std::size_t StringTable::get_index(StringView str)
 {
-	auto itr = p_impl->str_hash.find(str);
-	if (itr == p_impl->str_hash.end())
+	std::uint64_t hash = details::hash_str(str);
+	std::size_t index = p_impl->find(str, hash);
+	if (index != details::STRING_TABLE_NOT_FOUND)
 	{
-		return add_str(str);
+		return index;
 	}
-	else
+
+	// Another writer may add the same string before lock.
+	std::lock_guard<std::mutex> lock(p_impl->mutex);
+	index = p_impl->find(str, hash);
+	if (index != details::STRING_TABLE_NOT_FOUND)
 	{
-		return itr->second;
+		return index;
 	}
+	return p_impl->add_str(str, hash);
 }
 
 
 std::size_t StringTable::add_str(StringView str)
 {
-	char* storage = new char[str.length()];
-	copy_array(storage, str.data(), str.length());
-	StringView new_str(storage, str.length());
+	std::lock_guard<std::mutex> lock(p_impl->mutex);
+	return p_impl->add_str(str, details::hash_str(str));
+}
+
+
+void StringTable::set_str(std::size_t index, StringView str)
+{
+	std::lock_guard<std::mutex> lock(p_impl->mutex);
+	if (is_valid(p_impl->get_str(index)))
+	{
+		return;
+	}
+	p_impl->store_str(index, str, details::hash_str(str));
+}
+
+
+bool StringTable::replace_str(std::size_t index, StringView str)
+{
+	std::lock_guard<std::mutex> lock(p_impl->mutex);
+	if (p_impl->persistent)
+	{
+		LIGHTS_THROW(InvalidArgument, "StringTable: Cannot replace string that saves into file");
+	}
 
-	p_impl->str_array.push_back(new_str);
-	auto pair = std::make_pair(new_str, p_impl->str_array.size() - 1);
-	p_impl->str_hash.insert(pair);
-	return pair.second;
+	StringView old_str = p_impl->get_str(index);
+	if (is_valid(old_str) &&
+		old_str.length() == str.length() &&
+		std::memcmp(old_str.data(), str.data(), str.length()) == 0)
+	{
+		return false;
+	}
+	p_impl->store_str(index, str, details::hash_str(str));
+	return true;
 }
 
 
 StringView StringTable::get_str(std::size_t index) const
 {
-	if (index < p_impl->str_array.size())
+	return p_impl->get_str(index);
+}
+
+
+std::size_t StringTable::size() const
+{
+	return p_impl->size.load(std::memory_order_acquire);
+}
+
+
+void StringTable::set_flush_policy(const StringTableFlushPolicy& policy)
+{
+	p_impl->flush_policy = policy;
+}
+
+
+const StringTableFlushPolicy& StringTable::flush_policy() const
+{
+	return p_impl->flush_policy;
+}
+
+
+void StringTable::flush_by_policy()
+{
+	std::size_t count = p_impl->pending_count.load(std::memory_order_acquire);
+	if (count == 0)
 	{
-		return p_impl->str_array[index];
+		return;
 	}
-	else
+
+	const StringTableFlushPolicy& policy = p_impl->flush_policy;
+	std::int64_t wait_time = ImplementType::steady_now() - p_impl->first_pending_time.load(std::memory_order_relaxed);
+	if ((policy.max_pending_count != 0 && count >= policy.max_pending_count) ||
+		(policy.max_pending_time.count() != 0 &&
+		 wait_time >= std::chrono::duration_cast<std::chrono::nanoseconds>(policy.max_pending_time).count()))
 	{
-		return invalid_string_view();
+		p_impl->flush();
 	}
 }
 
+
+bool StringTable::flush()
+{
+	return p_impl->flush();
+}
+
 } // namespace lights
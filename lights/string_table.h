@@ -6,6 +6,8 @@
 
 #pragma once
 
+#include <chrono>
+
 #include "sequence.h"
 #include "non_copyable.h"
 
@@ -19,16 +21,58 @@ struct StringTableImpl;
 } // namespace details
 
 
+/**
+ * StringTableFlushPolicy decides when new strings are written into file.
+ * @details New string is pending until one of condition is satisfied. Zero disables the condition.
+ */
+struct StringTableFlushPolicy
+{
+	std::size_t max_pending_count = 1; // Writes when number of pending string reaches it.
+	std::chrono::milliseconds max_pending_time = std::chrono::milliseconds(0); // Writes when the first pending string waits so long.
+	bool flush_on_new_file = true; // Writes when log file format begins a file, such as rotating file.
+	bool sync = false; // Synchronizes file with disk after writing, so strings are kept even if system crashes.
+};
+
+
+/**
+ * Mode of opening string table file.
+ */
+enum class StringTableOpenMode
+{
+	READ_WRITE, // Saves new strings into file.
+	READ_ONLY, // Never writes file, new strings are only in memory.
+};
+
+
 /**
  * StringTable record string with index.
+ * @details All operation is thread safe, so it can be share by multiple logger and thread.
+ *          Getting string by index and finding index of existing string never lock, only
+ *          adding new string is serialized. String never moves after it's added, so returned
+ *          string is valid until string table is destroyed.
  */
 class StringTable : public NonCopyable
 {
 public:
 	/**
-	 * Creates string table.
+	 * Creates string table that only in memory.
+	 */
+	StringTable();
+
+	/**
+	 * Creates string table that is loaded from @c filename and saves new strings into it.
+	 * @details File is an image that is mapped and use directly, so loading not depends on
+	 *          number of string. New string is appended after image as record by flush policy,
+	 *          and records are merged into image when string table that appends them is destroyed.
+	 *          Text file that records one string per line is also supported. File is created or
+	 *          converted to image only when the first new string is written.
+	 * @throw Thrown OpenFileError when file is not exist in read only mode, and InvalidArgument
+	 *        when image is broken or file is written by another string table.
+	 * @note File can be written by only one string table at the same time, include string
+	 *       table of other process. It's lock by file "<filename>.lock" until string table is
+	 *       destroyed. Reader should use read only mode.
 	 */
-	StringTable(StringView filename);
+	StringTable(StringView filename, StringTableOpenMode mode = StringTableOpenMode::READ_WRITE);
 
 	/**
 	 * Destroys string table.
@@ -46,21 +90,74 @@ public:
 	 */
 	std::size_t add_str(StringView str);
 
+	/**
+	 * Sets string at @c index when there is no string at it. Use to rebuild string table
+	 * with known index.
+	 * @note Index in front of @c index that have no string is reserve and get_str returns nullptr.
+	 */
+	void set_str(std::size_t index, StringView str);
+
+	/**
+	 * Sets string at @c index even if there is a string at it. Use to rebuild string table
+	 * from source that may give different string to the same index.
+	 * @return Returns false when string at @c index is already @c str.
+	 * @details Replaced string is still valid, but index of it cannot be found any more.
+	 * @throw Thrown InvalidArgument when string table saves new strings into file.
+	 */
+	bool replace_str(std::size_t index, StringView str);
+
 	/**
 	 * Gets string by index.
 	 * @note Return nullptr if index is invalid.
 	 */
 	StringView get_str(std::size_t index) const;
 
+	/**
+	 * Returns number of index, include the reserve index.
+	 */
+	std::size_t size() const;
+
 	/**
 	 * Gets string by index.
 	 * @note Return nullptr if index is invalid.
 	 */
 	StringView operator[] (std::size_t index) const;
 
+	/**
+	 * Sets policy of writing new strings into file.
+	 * @note Must set before string table is share with another thread.
+	 */
+	void set_flush_policy(const StringTableFlushPolicy& policy);
+
+	/**
+	 * Returns policy of writing new strings into file.
+	 */
+	const StringTableFlushPolicy& flush_policy() const;
+
+	/**
+	 * Writes new strings into file when flush policy is satisfied.
+	 * @details BinaryLogFileFormat calls it before writing log message, so strings are written
+	 *          in backend thread of asynchronous sink instead of logging thread.
+	 *          Caller must call it periodically when there is no BinaryLogFileFormat.
+	 */
+	void flush_by_policy();
+
+	/**
+	 * Writes all new strings into file.
+	 * @return Returns false when cannot write file, and strings will be written next time.
+	 */
+	bool flush();
+
+	/**
+	 * Returns id that is unique in all string table of process. It's use to identify
+	 * string table even if a string table is destroyed and another is create at the same address.
+	 */
+	std::size_t id() const;
+
 private:
 	using ImplementType = details::StringTableImpl;
 	ImplementType* p_impl;
+	std::size_t m_id;
 };
 
 
@@ -71,4 +168,9 @@ inline StringView StringTable::operator[](std::size_t index) const
 	return get_str(index);
 }
 
+inline std::size_t StringTable::id() const
+{
+	return m_id;
+}
+
 } // namespace lights